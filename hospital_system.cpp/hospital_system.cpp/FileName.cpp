@@ -1,15 +1,32 @@
 // hospital_system.cpp
 // Full Hospital Management System (Option B)
 // - Patient Management (Linked List, QuickSort, BinarySearch)
+// - Policy-based PatientStore: list/vector/hash/B+ tree storage, id indexes,
+//   pool allocator, chosen at compile time
+// - Copy-on-write patient snapshots for reports and saves
+// - Id-range sharded patient files with lazy, parallel load/save
+// - Patient memory accounting and a budget: CLOCK eviction of saved shards
+// - Bloom filters on patient ids for fast negative lookups
 // - Appointment Management (Queue for routine appointments)
 // - Emergency Management (Priority Queue for emergency cases, Linear search)
+// - Queue time series: per-minute/hour arrival, service and wait buckets
+// - Emergency dispatch to free doctors (preferences, specialties, priority aging)
+// - Discrete-event hospital simulation (Poisson arrivals, virtual clock)
 // - Doctor/Staff database (unordered_map hash table)
 // - Reporting & Analytics (MergeSort and BST for hierarchical analysis)
+// - Trending ailments: windowed count-min sketches + Space-Saving top-k
+// - External-memory sort (sorted runs + heap k-way merge) for streaming reports
+// - Multi-file patient import with k-way id merge and conflict policies
 // - File persistence for patients, appointments, emergencies, doctors
+// - Packed binary format (delta/varint ids, dictionary columns, CRC blocks)
+// - Per-operation latency histograms with a stats menu and JSON dump
+// - Headless batch command mode (--batch) for bulk ingestion
+// - Unix domain socket server (--serve): epoll loop, worker pool, pipelining
 // - Console menu UI
 //
 // Author: Generated for Option B request
-// Compile: g++ -std=c++17 hospital_system.cpp -o hospital_system
+// Compile: g++ -std=c++17 -pthread hospital_system.cpp -o hospital_system
+//          (or CMake, which also builds the hospital_bench benchmarks)
 
 #include <iostream>
 #include <fstream>
@@ -18,10 +35,34 @@
 #include <queue>
 #include <functional>       // for std::greater / std::less
 #include <unordered_map>
+#include <map>
+#include <set>
 #include <iomanip>
 #include <algorithm>        // swap, sort
 #include <limits>
 #include <sstream>
+#include <cstdio>           // std::remove for temporary run files
+#include <cstring>
+#include <cstdint>          // uint32_t checksums in the packed format
+#include <cerrno>           // a missing shard file vs. an unreadable one
+#include <deque>
+#include <condition_variable>
+#include <csignal>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include <memory>           // shared_ptr for copy-on-write snapshots
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>           // simulator arrival / service-time draws
 
 using namespace std;
 
@@ -42,6 +83,22 @@ int getInt(const string& prompt) {
     }
 }
 
+double getDouble(const string& prompt) {
+    while (true) {
+        cout << prompt;
+        double x;
+        if (cin >> x && isfinite(x)) {
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return x;
+        }
+        else {
+            cout << "Invalid number. Try again.\n";
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+    }
+}
+
 string getLine(const string& prompt) {
     cout << prompt;
     string s;
@@ -49,6 +106,243 @@ string getLine(const string& prompt) {
     return s;
 }
 
+// Wall-clock milliseconds, used to timestamp queued items.
+inline long long nowMillis() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Splits "a|b|c" into its fields (empty fields are kept).
+vector<string> splitFields(const string& line, char sep = '|') {
+    vector<string> parts;
+    string cur;
+    for (size_t i = 0; i <= line.size(); ++i) {
+        if (i == line.size() || line[i] == sep) {
+            parts.push_back(cur);
+            cur.clear();
+        }
+        else cur.push_back(line[i]);
+    }
+    return parts;
+}
+
+// Returns what follows the n-th separator of line ("" if there are fewer),
+// for a trailing free-text field that may contain the separator itself.
+string fieldsAfter(const string& line, size_t n, char sep = '|') {
+    size_t pos = 0;
+    for (size_t i = 0; i < n; ++i) {
+        pos = line.find(sep, pos);
+        if (pos == string::npos) return "";
+        ++pos;
+    }
+    return line.substr(pos);
+}
+
+// Splits "notes|arrival" at its last '|', since free-text notes may contain
+// '|' themselves. When the last field is not a timestamp (files written
+// before arrivals were stored) all of rest is notes and arrival is 0.
+void splitNotesArrival(const string& rest, string& notes, long long& arrival) {
+    notes = rest;
+    arrival = 0;
+    size_t bar = rest.rfind('|');
+    if (bar == string::npos || bar + 1 == rest.size()) return;
+    long long v = 0;
+    for (size_t i = bar + 1; i < rest.size(); ++i) {
+        if (rest[i] < '0' || rest[i] > '9' || v > (numeric_limits<long long>::max() - 9) / 10) return;
+        v = v * 10 + (rest[i] - '0');
+    }
+    notes = rest.substr(0, bar);
+    arrival = v;
+}
+
+// Runs fn(0..n-1) on up to hardware_concurrency threads.
+template <typename Fn>
+void parallelFor(int n, Fn fn) {
+    int workers = min(n, max(1, (int)thread::hardware_concurrency()));
+    if (workers <= 1) {
+        for (int i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    atomic<int> next(0);
+    vector<thread> pool;
+    for (int w = 0; w < workers; ++w) {
+        pool.emplace_back([&]() {
+            for (int i = next++; i < n; i = next++) fn(i);
+        });
+    }
+    for (auto& t : pool) t.join();
+}
+
+// ---------------------------- Instrumentation -----------------------------
+// Log-linear latency histogram (HDR style): 32 sub-buckets per power of two,
+// so any recorded value is reported within ~3%. Recording is a handful of
+// relaxed atomic adds and safe from any thread.
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 5;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = SUB + (64 - SUB_BITS) * SUB;
+
+    vector<atomic<unsigned long long>> counts;
+    atomic<unsigned long long> total;
+    atomic<unsigned long long> sum;
+    atomic<unsigned long long> maxSeen;
+
+    static int msb(unsigned long long v) {
+        int r = 0;
+        while (v >>= 1) ++r;
+        return r;
+    }
+    static int bucketOf(unsigned long long v) {
+        if (v < (unsigned long long)SUB) return (int)v;
+        int m = msb(v);
+        int sub = (int)((v >> (m - SUB_BITS)) & (SUB - 1));
+        return SUB + (m - SUB_BITS) * SUB + sub;
+    }
+    // upper edge of a bucket, used as the reported value
+    static unsigned long long bucketHigh(int idx) {
+        if (idx < SUB) return (unsigned long long)idx;
+        int m = (idx - SUB) / SUB + SUB_BITS;
+        int sub = (idx - SUB) % SUB;
+        unsigned long long width = 1ULL << (m - SUB_BITS);
+        return ((unsigned long long)(SUB + sub) << (m - SUB_BITS)) + width - 1;
+    }
+public:
+    LatencyHistogram() : counts(BUCKETS), total(0), sum(0), maxSeen(0) {
+        for (auto& c : counts) c.store(0, memory_order_relaxed);
+    }
+
+    void record(unsigned long long ns) {
+        counts[bucketOf(ns)].fetch_add(1, memory_order_relaxed);
+        total.fetch_add(1, memory_order_relaxed);
+        sum.fetch_add(ns, memory_order_relaxed);
+        unsigned long long prev = maxSeen.load(memory_order_relaxed);
+        while (ns > prev && !maxSeen.compare_exchange_weak(prev, ns, memory_order_relaxed)) {}
+    }
+
+    unsigned long long count() const { return total.load(memory_order_relaxed); }
+    unsigned long long max() const { return maxSeen.load(memory_order_relaxed); }
+    double mean() const {
+        unsigned long long n = count();
+        return n ? (double)sum.load(memory_order_relaxed) / n : 0.0;
+    }
+
+    // q in [0, 1]
+    unsigned long long percentile(double q) const {
+        unsigned long long n = count();
+        if (n == 0) return 0;
+        // nearest rank: the smallest value with at least q*n samples at or below it
+        unsigned long long rank = (unsigned long long)ceil(q * (double)n);
+        if (rank == 0) rank = 1;
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i].load(memory_order_relaxed);
+            if (seen >= rank) return std::min(bucketHigh(i), max());
+        }
+        return max();
+    }
+
+    void reset() {
+        for (auto& c : counts) c.store(0, memory_order_relaxed);
+        total = 0;
+        sum = 0;
+        maxSeen = 0;
+    }
+};
+
+// Named histograms, one per "store.operation". Look one up once (e.g. into a
+// function-local static) and record into it on the hot path.
+class StatsRegistry {
+private:
+    map<string, unique_ptr<LatencyHistogram>> ops;
+    mutable mutex mtx;
+public:
+    static StatsRegistry& instance() {
+        static StatsRegistry reg;
+        return reg;
+    }
+
+    // Nonzero while the calling thread runs synthetic load (see StatsPause).
+    static int& pauseDepth() {
+        static thread_local int depth = 0;
+        return depth;
+    }
+    static bool paused() { return pauseDepth() > 0; }
+
+    LatencyHistogram& histogram(const string& name) {
+        lock_guard<mutex> lk(mtx);
+        auto& h = ops[name];
+        if (!h) h = make_unique<LatencyHistogram>();
+        return *h;
+    }
+
+    void resetAll() {
+        lock_guard<mutex> lk(mtx);
+        for (auto& kv : ops) kv.second->reset();
+    }
+
+    void printTable(ostream& out) const {
+        lock_guard<mutex> lk(mtx);
+        ios::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+        out << left << setw(32) << "Operation" << right << setw(10) << "Count" << setw(12) << "Mean(us)"
+            << setw(12) << "p50(us)" << setw(12) << "p99(us)" << setw(12) << "Max(us)" << '\n';
+        out << string(90, '-') << '\n';
+        for (const auto& kv : ops) {
+            const LatencyHistogram& h = *kv.second;
+            if (h.count() == 0) continue;
+            out << left << setw(32) << kv.first << right << setw(10) << h.count() << fixed << setprecision(2)
+                << setw(12) << h.mean() / 1000.0 << setw(12) << h.percentile(0.50) / 1000.0
+                << setw(12) << h.percentile(0.99) / 1000.0 << setw(12) << h.max() / 1000.0 << '\n';
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    // {"operations":[{"name":...,"count":...,"mean_ns":...,"p50_ns":...,...}]}
+    void writeJson(ostream& out) const {
+        lock_guard<mutex> lk(mtx);
+        out << "{\"operations\":[";
+        bool first = true;
+        for (const auto& kv : ops) {
+            const LatencyHistogram& h = *kv.second;
+            if (!first) out << ',';
+            first = false;
+            out << "{\"name\":\"" << kv.first << "\",\"count\":" << h.count()
+                << ",\"mean_ns\":" << (unsigned long long)h.mean()
+                << ",\"p50_ns\":" << h.percentile(0.50) << ",\"p90_ns\":" << h.percentile(0.90)
+                << ",\"p99_ns\":" << h.percentile(0.99) << ",\"p999_ns\":" << h.percentile(0.999)
+                << ",\"max_ns\":" << h.max() << '}';
+        }
+        out << "]}\n";
+    }
+};
+
+inline LatencyHistogram& opStats(const string& name) { return StatsRegistry::instance().histogram(name); }
+
+// Keeps the calling thread's operations out of the registry for its
+// lifetime, e.g. while the simulator drives its private managers.
+class StatsPause {
+public:
+    StatsPause() { ++StatsRegistry::pauseDepth(); }
+    ~StatsPause() { --StatsRegistry::pauseDepth(); }
+    StatsPause(const StatsPause&) = delete;
+    StatsPause& operator=(const StatsPause&) = delete;
+};
+
+// Records the lifetime of the enclosing scope into a histogram.
+class ScopedTimer {
+private:
+    LatencyHistogram& hist;
+    chrono::steady_clock::time_point start;
+public:
+    explicit ScopedTimer(LatencyHistogram& h) : hist(h), start(chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        if (StatsRegistry::paused()) return;
+        hist.record((unsigned long long)chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - start).count());
+    }
+};
+
 // ---------------------------- Patient Entity ------------------------------
 class Patient {
 public:
@@ -99,206 +393,393 @@ public:
     }
 };
 
-// ---------------------------- Linked List for Patients --------------------
-class PatientNode {
+// ---------------------------- Packed Storage Format ----------------------
+// Compact binary alternative to the pipe-delimited text files:
+//   "HSPK" version kind  block...  0
+//   block = records(varint) payloadBytes(varint) crc32(4 bytes LE) payload
+// A block holds up to PACKED_BLOCK records stored column by column. Integers
+// are zigzag varints, ids as deltas from the previous record (sorted ids cost
+// about one byte); low-cardinality strings (gender, ailment, doctor, notes)
+// are indexes into a dictionary carried by the block; other strings are
+// length-prefixed. Blocks are self-contained, so readers decode one at a time
+// in bounded memory and a damaged block fails its checksum. Loaders detect
+// the format from the magic bytes, so text and packed files can be mixed.
+enum class StorageFormat { Text, Packed };
+
+inline const char* formatName(StorageFormat f) { return f == StorageFormat::Packed ? "packed" : "text"; }
+
+static const size_t PACKED_BLOCK = 4096;
+static const char PACKED_MAGIC[4] = { 'H', 'S', 'P', 'K' };
+static const char PACKED_VERSION = 1;
+
+inline uint32_t crc32(const char* data, size_t n) {
+    static const vector<uint32_t> table = []() {
+        vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; ++i) c = table[(c ^ (unsigned char)data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+class ByteWriter {
 public:
-    Patient data;
-    PatientNode* next;
-    PatientNode(const Patient& p) : data(p), next(nullptr) {}
+    string buf;
+    void putVarint(unsigned long long v) {
+        while (v >= 0x80) {
+            buf.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        buf.push_back((char)v);
+    }
+    void putSigned(long long v) { putVarint(((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63)); }
+    void putString(const string& s) {
+        putVarint(s.size());
+        buf.append(s);
+    }
 };
 
-class PatientList {
+// Reads from a byte range; any overrun clears good() instead of throwing.
+class ByteReader {
 private:
-    PatientNode* head;
-    int count;
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok;
 public:
-    PatientList() : head(nullptr), count(0) {}
-    ~PatientList() { clear(); }
-
-    bool empty() const { return head == nullptr; }
-    int size() const { return count; }
-
-    bool addPatient(const Patient& p) {
-        if (findById(p.id) != nullptr) return false; // duplicate id
-        PatientNode* node = new PatientNode(p);
-        if (!head) head = node;
-        else {
-            PatientNode* cur = head;
-            while (cur->next) cur = cur->next;
-            cur->next = node;
+    ByteReader(const string& s) : p((const unsigned char*)s.data()), end(p + s.size()), ok(true) {}
+    bool good() const { return ok; }
+    bool atEnd() const { return p == end; }
+    unsigned long long getVarint() {
+        unsigned long long v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            unsigned char b = *p++;
+            v |= (unsigned long long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
         }
-        ++count;
-        return true;
+        ok = false;
+        return 0;
+    }
+    long long getSigned() {
+        unsigned long long u = getVarint();
+        return (long long)(u >> 1) ^ -(long long)(u & 1);
+    }
+    void getString(string& s) {
+        unsigned long long n = getVarint();
+        if (!ok || n > (unsigned long long)(end - p)) {
+            ok = false;
+            return;
+        }
+        s.assign((const char*)p, (size_t)n);
+        p += n;
     }
+};
 
-    bool removeById(int id) {
-        if (!head) return false;
-        if (head->data.id == id) {
-            PatientNode* tmp = head;
-            head = head->next;
-            delete tmp;
-            --count;
-            return true;
+// One dictionary-encoded string column: the distinct values, then one index
+// per record.
+class DictColumn {
+private:
+    unordered_map<string, unsigned> ids;
+    vector<string> values;
+    vector<unsigned> rows;
+public:
+    void add(const string& s) {
+        auto it = ids.find(s);
+        if (it == ids.end()) {
+            it = ids.emplace(s, (unsigned)values.size()).first;
+            values.push_back(s);
         }
-        PatientNode* cur = head;
-        while (cur->next && cur->next->data.id != id) cur = cur->next;
-        if (cur->next && cur->next->data.id == id) {
-            PatientNode* tmp = cur->next;
-            cur->next = tmp->next;
-            delete tmp;
-            --count;
-            return true;
+        rows.push_back(it->second);
+    }
+    void writeTo(ByteWriter& w) const {
+        w.putVarint(values.size());
+        for (const auto& v : values) w.putString(v);
+        for (unsigned r : rows) w.putVarint(r);
+    }
+    // Calls set(i, value) for each of n records.
+    template <typename Fn>
+    static bool read(ByteReader& r, size_t n, Fn set) {
+        unsigned long long count = r.getVarint();
+        if (!r.good() || count > n) return false;
+        vector<string> dict((size_t)count);
+        for (auto& d : dict) r.getString(d);
+        for (size_t i = 0; i < n && r.good(); ++i) {
+            unsigned long long k = r.getVarint();
+            if (k >= count) return false;
+            set(i, dict[(size_t)k]);
         }
-        return false;
+        return r.good();
     }
+};
 
-    PatientNode* findById(int id) const {
-        PatientNode* cur = head;
-        while (cur) {
-            if (cur->data.id == id) return cur;
-            cur = cur->next;
+struct PatientCodec {
+    typedef Patient Record;
+    static const char kind = 'P';
+    static void encode(const vector<Patient>& v, ByteWriter& w) {
+        long long prev = 0;
+        for (const auto& p : v) {
+            w.putSigned(p.id - prev);
+            prev = p.id;
         }
-        return nullptr;
+        for (const auto& p : v) w.putSigned(p.age);
+        for (const auto& p : v) w.putSigned(p.priority);
+        DictColumn gender, ailment, doctor;
+        for (const auto& p : v) {
+            gender.add(p.gender);
+            ailment.add(p.ailment);
+            doctor.add(p.assignedDoctor);
+        }
+        gender.writeTo(w);
+        ailment.writeTo(w);
+        doctor.writeTo(w);
+        for (const auto& p : v) w.putString(p.name);
+        for (const auto& p : v) w.putString(p.phone);
     }
-
-    vector<Patient> toVector() const {
-        vector<Patient> v;
-        PatientNode* cur = head;
-        while (cur) {
-            v.push_back(cur->data);
-            cur = cur->next;
+    static bool decode(ByteReader& r, vector<Patient>& v) {
+        long long prev = 0;
+        for (auto& p : v) {
+            prev += r.getSigned();
+            p.id = (int)prev;
         }
-        return v;
+        for (auto& p : v) p.age = (int)r.getSigned();
+        for (auto& p : v) p.priority = (int)r.getSigned();
+        if (!DictColumn::read(r, v.size(), [&](size_t i, const string& s) { v[i].gender = s; })) return false;
+        if (!DictColumn::read(r, v.size(), [&](size_t i, const string& s) { v[i].ailment = s; })) return false;
+        if (!DictColumn::read(r, v.size(), [&](size_t i, const string& s) { v[i].assignedDoctor = s; })) return false;
+        for (auto& p : v) r.getString(p.name);
+        for (auto& p : v) r.getString(p.phone);
+        return r.good() && r.atEnd();
     }
+};
 
-    void replaceFromVector(const vector<Patient>& v) {
-        clear();
-        for (const auto& p : v) addPatient(p);
+inline bool isPackedFile(const string& filename) {
+    ifstream fin(filename, ios::binary);
+    char magic[4];
+    return fin.read(magic, 4) && memcmp(magic, PACKED_MAGIC, 4) == 0;
+}
+
+// Buffers records and writes them a block at a time.
+template <typename Codec>
+class PackedWriter {
+private:
+    typedef typename Codec::Record Record;
+    ofstream out;
+    vector<Record> block;
+    ByteWriter payload;
+
+    void flush() {
+        if (block.empty()) return;
+        payload.buf.clear();
+        Codec::encode(block, payload);
+        ByteWriter head;
+        head.putVarint(block.size());
+        head.putVarint(payload.buf.size());
+        uint32_t c = crc32(payload.buf.data(), payload.buf.size());
+        for (int i = 0; i < 4; ++i) head.buf.push_back((char)(c >> (8 * i)));
+        out.write(head.buf.data(), head.buf.size());
+        out.write(payload.buf.data(), payload.buf.size());
+        block.clear();
+    }
+public:
+    explicit PackedWriter(const string& filename) : out(filename, ios::binary) {
+        block.reserve(PACKED_BLOCK);
+        out.write(PACKED_MAGIC, 4);
+        out.put(PACKED_VERSION);
+        out.put(Codec::kind);
+    }
+    bool isOpen() const { return out.is_open(); }
+    void add(const Record& r) {
+        block.push_back(r);
+        if (block.size() == PACKED_BLOCK) flush();
     }
+    bool finish() {
+        flush();
+        out.put(0);                 // a zero-record block ends the file
+        out.close();
+        return !out.fail();
+    }
+};
 
-    void displayAll() const {
-        if (!head) {
-            cout << "No patient records.\n";
-            return;
-        }
-        cout << left << setw(6) << "ID" << setw(20) << "Name" << setw(6) << "Age"
-            << setw(8) << "Gender" << setw(15) << "Ailment" << setw(9) << "Priority"
-            << setw(15) << "Doctor" << setw(12) << "Phone" << '\n';
-        cout << string(95, '-') << '\n';
-        PatientNode* cur = head;
-        while (cur) {
-            const Patient& p = cur->data;
-            cout << setw(6) << p.id << setw(20) << p.name << setw(6) << p.age
-                << setw(8) << p.gender << setw(15) << p.ailment << setw(9) << p.priority
-                << setw(15) << p.assignedDoctor << setw(12) << p.phone << '\n';
-            cur = cur->next;
+// Decodes a packed file one block at a time. Stops at the end marker, or at
+// the first truncated or corrupt block, after which ok() is false.
+template <typename Codec>
+class PackedReader {
+private:
+    typedef typename Codec::Record Record;
+    ifstream in;
+    string payload;
+    bool failed;
+    bool done;
+
+    bool readVarint(unsigned long long& v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int b = in.get();
+            if (b == EOF) return false;
+            v |= (unsigned long long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
         }
+        return false;
     }
-
-    bool saveToFile(const string& filename = "patients.txt") const {
-        ofstream fout(filename);
-        if (!fout.is_open()) return false;
-        PatientNode* cur = head;
-        while (cur) {
-            fout << cur->data.serialize() << '\n';
-            cur = cur->next;
+public:
+    explicit PackedReader(const string& filename) : in(filename, ios::binary), failed(false), done(false) {
+        char head[6];
+        if (!in.read(head, 6) || memcmp(head, PACKED_MAGIC, 4) != 0 || head[4] != PACKED_VERSION
+            || head[5] != Codec::kind) {
+            failed = true;
+            done = true;
         }
-        fout.close();
-        return true;
     }
+    bool ok() const { return !failed; }
 
-    bool loadFromFile(const string& filename = "patients.txt") {
-        ifstream fin(filename);
-        if (!fin.is_open()) return false;
-        clear();
-        string line;
-        while (getline(fin, line)) {
-            Patient p;
-            if (Patient::deserialize(line, p)) addPatient(p);
+    // Replaces out with the next good block's records; false at the end or
+    // when the framing is broken. A block that fails its checksum or does
+    // not decode is skipped and ok() turns false, so callers can keep the
+    // rest of the file.
+    bool nextBlock(vector<Record>& out) {
+        while (!done) {
+            if (readBlock(out)) return true;
         }
-        fin.close();
-        return true;
+        return false;
     }
 
-    void clear() {
-        PatientNode* cur = head;
-        while (cur) {
-            PatientNode* nxt = cur->next;
-            delete cur;
-            cur = nxt;
+private:
+    // false with done unset: this block was bad, the next may be fine
+    bool readBlock(vector<Record>& out) {
+        unsigned long long n = 0, bytes = 0;
+        unsigned char c[4];
+        if (!readVarint(n) || (n > 0 && (!readVarint(bytes) || !in.read((char*)c, 4)))) {
+            failed = true;
+            done = true;
+            return false;
         }
-        head = nullptr;
-        count = 0;
+        if (n == 0) {
+            done = true;
+            return false;
+        }
+        uint32_t want = (uint32_t)c[0] | (uint32_t)c[1] << 8 | (uint32_t)c[2] << 16 | (uint32_t)c[3] << 24;
+        if (n > PACKED_BLOCK || bytes > (1ULL << 30)) {
+            failed = true;
+            done = true;
+            return false;
+        }
+        payload.resize((size_t)bytes);
+        if (!in.read(&payload[0], (streamsize)bytes)) {
+            failed = true;
+            done = true;
+            return false;
+        }
+        out.assign((size_t)n, Record());
+        ByteReader r(payload);
+        if (crc32(payload.data(), payload.size()) != want || !Codec::decode(r, out)) {
+            failed = true;
+            return false;
+        }
+        return true;
     }
 };
 
-// ---------------------------- QuickSort & Binary Search -------------------
-// QuickSort by patient id
-int partition(vector<Patient>& arr, int low, int high) {
-    int pivot = arr[high].id;
-    int i = low - 1;
-    for (int j = low; j <= high - 1; ++j) {
-        if (arr[j].id <= pivot) {
-            ++i;
-            swap(arr[i], arr[j]);
-        }
-    }
-    swap(arr[i + 1], arr[high]);
-    return (i + 1);
-}
+// ---------------------------- Bloom Filter on Patient IDs ----------------
+// Answers "definitely absent" or "maybe present" for an id. Sized at ~10 bits
+// per id with 7 probes (~1% false positives). Removals leave bits set, which
+// only costs an occasional extra probe; the filter is rebuilt on load.
+class IdBloomFilter {
+private:
+    vector<unsigned long long> words;
+    int numHashes;
+    int capacity;               // ids the filter was sized for
 
-void quickSort(vector<Patient>& arr, int low, int high) {
-    if (low < high) {
-        int pi = partition(arr, low, high);
-        quickSort(arr, low, pi - 1);
-        quickSort(arr, pi + 1, high);
+    static unsigned long long mix(int id) {
+        // splitmix64 finalizer
+        unsigned long long z = (unsigned long long)(unsigned int)id + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
     }
-}
+public:
+    IdBloomFilter(int expected = 64) { reset(expected); }
 
-// Binary search on sorted vector by id
-int binarySearchById(const vector<Patient>& arr, int id) {
-    int l = 0, r = (int)arr.size() - 1;
-    while (l <= r) {
-        int m = l + (r - l) / 2;
-        if (arr[m].id == id) return m;
-        if (arr[m].id < id) l = m + 1;
-        else r = m - 1;
+    void reset(int expected) {
+        capacity = max(64, expected);
+        size_t bits = (size_t)capacity * 10;
+        words.assign((bits + 63) / 64, 0);
+        numHashes = 7;
     }
-    return -1;
-}
 
-// ---------------------------- Appointment Management ---------------------
-struct Appointment {
-    int patientId;
-    string timeSlot;
-    string notes;
+    int capacityHint() const { return capacity; }
+    size_t bytes() const { return words.capacity() * sizeof(unsigned long long); }
 
-    Appointment() : patientId(0), timeSlot(""), notes("") {}
-    Appointment(int pid, const string& ts, const string& n) : patientId(pid), timeSlot(ts), notes(n) {}
+    void add(int id) {
+        unsigned long long h = mix(id);
+        unsigned long long h1 = h, h2 = (h >> 32) | 1;
+        size_t m = words.size() * 64;
+        for (int i = 0; i < numHashes; ++i) {
+            size_t b = (size_t)((h1 + i * h2) % m);
+            words[b / 64] |= 1ULL << (b % 64);
+        }
+    }
 
-    string serialize() const {
-        // pid|timeslot|notes
-        ostringstream oss;
-        oss << patientId << '|' << timeSlot << '|' << notes;
-        return oss.str();
+    bool mightContain(int id) const {
+        unsigned long long h = mix(id);
+        unsigned long long h1 = h, h2 = (h >> 32) | 1;
+        size_t m = words.size() * 64;
+        for (int i = 0; i < numHashes; ++i) {
+            size_t b = (size_t)((h1 + i * h2) % m);
+            if (!(words[b / 64] & (1ULL << (b % 64)))) return false;
+        }
+        return true;
     }
 
-    static bool deserialize(const string& line, Appointment& a) {
-        if (line.empty()) return false;
-        vector<string> parts;
-        string cur;
-        for (size_t i = 0; i <= line.size(); ++i) {
-            if (i == line.size() || line[i] == '|') {
-                parts.push_back(cur);
-                cur.clear();
+    // Format: capacity|hashes|word1;word2;... (hex)
+    // Written to a temporary file and renamed over the old one. If that
+    // fails the old filter is deleted too: a stale filter would wrongly rule
+    // out ids added since, while a missing one only costs a shard load.
+    bool saveToFile(const string& filename) const {
+        string tmp = filename + ".tmp";
+        ofstream fout(tmp);
+        if (fout.is_open()) {
+            fout << capacity << '|' << numHashes << '|' << hex;
+            for (size_t i = 0; i < words.size(); ++i) {
+                fout << words[i];
+                if (i + 1 < words.size()) fout << ';';
             }
-            else cur.push_back(line[i]);
+            fout << '\n';
+            fout.close();
+            if (fout && std::rename(tmp.c_str(), filename.c_str()) == 0) return true;
         }
-        if (parts.size() < 3) return false;
+        std::remove(tmp.c_str());
+        std::remove(filename.c_str());
+        return false;
+    }
+
+    bool loadFromFile(const string& filename) {
+        ifstream fin(filename);
+        if (!fin.is_open()) return false;
+        string line;
+        if (!getline(fin, line)) return false;
+        size_t p1 = line.find('|');
+        size_t p2 = line.find('|', p1 == string::npos ? p1 : p1 + 1);
+        if (p1 == string::npos || p2 == string::npos) return false;
         try {
-            a.patientId = stoi(parts[0]);
-            a.timeSlot = parts[1];
-            a.notes = parts[2];
+            int cap = stoi(line.substr(0, p1));
+            int k = stoi(line.substr(p1 + 1, p2 - p1 - 1));
+            vector<unsigned long long> w;
+            string cur;
+            for (size_t i = p2 + 1; i <= line.size(); ++i) {
+                if (i == line.size() || line[i] == ';') {
+                    if (!cur.empty()) w.push_back(stoull(cur, nullptr, 16));
+                    cur.clear();
+                }
+                else cur.push_back(line[i]);
+            }
+            if (w.empty() || k <= 0) return false;
+            capacity = cap;
+            numHashes = k;
+            words = std::move(w);
             return true;
         }
         catch (...) {
@@ -307,395 +788,3917 @@ struct Appointment {
     }
 };
 
-class AppointmentManager {
-private:
-    queue<Appointment> routineQueue;
-public:
-    AppointmentManager() {}
+// ---------------------------- Patient Store (policy-based) ---------------
+// PatientStore<StoragePolicy, IndexPolicy, AllocatorPolicy> holds one set of
+// patients (a shard). Policies are picked at compile time, so every call is
+// resolved statically; there is no virtual dispatch on the hot path.
+//   StoragePolicy    how records are held: ListStorage (singly linked list,
+//                    insertion order), VectorStorage (contiguous, insertion
+//                    order), HashStorage (hash table keyed by id, no order),
+//                    BTreeStorage (B+ tree, id order)
+//   IndexPolicy      what answers findById before the storage is searched:
+//                    NoIndex, BloomIndex (negative id filter), HashIndex
+//                    (id -> record)
+//   AllocatorPolicy  where container nodes come from: StdAllocPolicy (global
+//                    heap) or PoolAllocPolicy (recycled fixed-size blocks)
+// Records are shared_ptr<const Patient>, so copying a version for
+// copy-on-write copies pointers, never patients.
+typedef shared_ptr<const Patient> PatientRef;
 
-    void scheduleRoutine(const Appointment& a) { routineQueue.push(a); }
-    bool hasRoutine() const { return !routineQueue.empty(); }
-    Appointment popNextRoutine() {
-        if (routineQueue.empty()) return Appointment();
-        Appointment a = routineQueue.front();
-        routineQueue.pop();
-        return a;
+// Heap bytes held by a store, by structure. Sizes follow the containers'
+// layouts (node size x count, array capacities) rather than allocator
+// internals, so they are close estimates, not exact RSS.
+struct MemoryUsage {
+    size_t records = 0;     // Patient objects with their shared_ptr control blocks
+    size_t strings = 0;     // string buffers that do not fit inline (SSO)
+    size_t nodes = 0;       // storage structure: list/tree nodes, vector or bucket arrays
+    size_t index = 0;       // id index: Bloom filter bits or hash table
+    size_t total() const { return records + strings + nodes + index; }
+    MemoryUsage& operator+=(const MemoryUsage& o) {
+        records += o.records;
+        strings += o.strings;
+        nodes += o.nodes;
+        index += o.index;
+        return *this;
     }
-    // persistence
-    bool saveToFile(const string& filename = "appointments.txt") const {
-        ofstream fout(filename);
-        if (!fout.is_open()) return false;
-        queue<Appointment> copy = routineQueue;
-        while (!copy.empty()) {
-            fout << copy.front().serialize() << '\n';
-            copy.pop();
+};
+
+// Record and string bytes of one patient (its storage node not included).
+inline MemoryUsage recordUsage(const Patient& p) {
+    static const size_t inlineCap = string().capacity();
+    MemoryUsage u;
+    u.records = sizeof(Patient) + 2 * sizeof(void*);
+    for (const string* f : { &p.name, &p.gender, &p.ailment, &p.phone, &p.assignedDoctor })
+        if (f->capacity() > inlineCap) u.strings += f->capacity() + 1;
+    return u;
+}
+
+// Free list of fixed-size blocks carved from 64 KB chunks. Each thread keeps
+// its own list and hands it back to the shared one when it exits; chunks are
+// kept for the life of the process.
+template <size_t Size, size_t Align>
+class NodePool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(Align) unsigned char bytes[Size];
+    };
+    struct Shared {
+        mutex mtx;
+        Slot* head = nullptr;
+    };
+    static Shared& shared() {
+        static Shared* s = new Shared();        // never destroyed: threads may exit after main
+        return *s;
+    }
+    struct Cache {
+        Slot* head = nullptr;
+        ~Cache() {
+            if (!head) return;
+            Slot* tail = head;
+            while (tail->next) tail = tail->next;
+            Shared& s = shared();
+            lock_guard<mutex> lk(s.mtx);
+            tail->next = s.head;
+            s.head = head;
         }
-        fout.close();
-        return true;
+    };
+    static Cache& cache() {
+        thread_local Cache c;
+        return c;
     }
-    bool loadFromFile(const string& filename = "appointments.txt") {
-        ifstream fin(filename);
-        if (!fin.is_open()) return false;
-        // clear existing
-        routineQueue = queue<Appointment>();
-        string line;
-        while (getline(fin, line)) {
-            Appointment a;
-            if (Appointment::deserialize(line, a)) routineQueue.push(a);
+public:
+    static void* take() {
+        Cache& c = cache();
+        if (!c.head) {
+            Shared& s = shared();
+            {
+                lock_guard<mutex> lk(s.mtx);
+                c.head = s.head;
+                s.head = nullptr;
+            }
+            if (!c.head) {
+                const size_t n = max<size_t>(1, 65536 / sizeof(Slot));
+                Slot* chunk = static_cast<Slot*>(::operator new(n * sizeof(Slot)));
+                for (size_t i = 0; i < n; ++i) {
+                    chunk[i].next = c.head;
+                    c.head = &chunk[i];
+                }
+            }
         }
-        fin.close();
-        return true;
+        Slot* slot = c.head;
+        c.head = slot->next;
+        return slot;
+    }
+    static void give(void* p) {
+        Cache& c = cache();
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = c.head;
+        c.head = slot;
     }
 };
 
-// ---------------------------- Emergency Management -----------------------
-struct EmergencyItem {
-    int patientId;
-    int priority; // higher = more urgent
-    string notes;
-    EmergencyItem() : patientId(0), priority(0), notes("") {}
-    EmergencyItem(int pid, int pr, const string& n) : patientId(pid), priority(pr), notes(n) {}
-    string serialize() const {
-        ostringstream oss;
-        oss << patientId << '|' << priority << '|' << notes;
-        return oss.str();
+// Standard-conforming allocator over NodePool for single objects (list, tree
+// and hash nodes, shared Patient records); arrays go to the global heap.
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+    PoolAllocator() noexcept {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+    T* allocate(size_t n) {
+        if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(NodePool<sizeof(T), alignof(T)>::take());
     }
-    static bool deserialize(const string& line, EmergencyItem& e) {
-        if (line.empty()) return false;
-        vector<string> parts;
-        string cur;
-        for (size_t i = 0; i <= line.size(); ++i) {
-            if (i == line.size() || line[i] == '|') {
-                parts.push_back(cur);
-                cur.clear();
-            }
-            else cur.push_back(line[i]);
+    void deallocate(T* p, size_t n) noexcept {
+        if (n != 1) ::operator delete(p);
+        else NodePool<sizeof(T), alignof(T)>::give(p);
+    }
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+};
+
+struct StdAllocPolicy {
+    template <typename T>
+    using type = std::allocator<T>;
+    static const char* name() { return "std"; }
+};
+
+struct PoolAllocPolicy {
+    template <typename T>
+    using type = PoolAllocator<T>;
+    static const char* name() { return "pool"; }
+};
+
+// Storage policies. Each holds PatientRefs and provides size, find, insert
+// (id known to be new), erase, replace (same id), forEach, clear and
+// nodeBytes (its own structure, records excluded); copying one copies the
+// references.
+template <typename AllocatorPolicy>
+class ListStorage {
+private:
+    struct Node {
+        PatientRef data;
+        Node* next;
+    };
+    typedef typename AllocatorPolicy::template type<Node> Alloc;
+    Node* head;
+    Node* tail;
+    size_t count;
+    Alloc alloc;
+public:
+    static const char* name() { return "list"; }
+    ListStorage() : head(nullptr), tail(nullptr), count(0) {}
+    ListStorage(const ListStorage& o) : head(nullptr), tail(nullptr), count(0) {
+        for (Node* cur = o.head; cur; cur = cur->next) insert(cur->data);
+    }
+    ListStorage& operator=(const ListStorage&) = delete;
+    ~ListStorage() { clear(); }
+
+    size_t size() const { return count; }
+    size_t nodeBytes() const { return count * sizeof(Node); }
+    const Patient* find(int id) const {
+        for (Node* cur = head; cur; cur = cur->next)
+            if (cur->data->id == id) return cur->data.get();
+        return nullptr;
+    }
+    void insert(PatientRef p) {
+        Node* node = alloc.allocate(1);
+        new (node) Node{ std::move(p), nullptr };
+        if (tail) tail->next = node;
+        else head = node;
+        tail = node;
+        ++count;
+    }
+    bool erase(int id) {
+        Node* prev = nullptr;
+        for (Node* cur = head; cur; prev = cur, cur = cur->next) {
+            if (cur->data->id != id) continue;
+            (prev ? prev->next : head) = cur->next;
+            if (tail == cur) tail = prev;
+            cur->~Node();
+            alloc.deallocate(cur, 1);
+            --count;
+            return true;
         }
-        if (parts.size() < 3) return false;
-        try {
-            e.patientId = stoi(parts[0]);
-            e.priority = stoi(parts[1]);
-            e.notes = parts[2];
+        return false;
+    }
+    bool replace(PatientRef p) {
+        for (Node* cur = head; cur; cur = cur->next) {
+            if (cur->data->id != p->id) continue;
+            cur->data = std::move(p);
             return true;
         }
-        catch (...) {
-            return false;
+        return false;
+    }
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (Node* cur = head; cur; cur = cur->next) fn(*cur->data);
+    }
+    void clear() {
+        while (head) {
+            Node* nxt = head->next;
+            head->~Node();
+            alloc.deallocate(head, 1);
+            head = nxt;
         }
+        tail = nullptr;
+        count = 0;
     }
 };
 
-// comparator for priority queue (max-heap)
-struct EmergencyCompare {
-    bool operator()(const EmergencyItem& a, const EmergencyItem& b) const {
-        return a.priority < b.priority; // top = highest priority
+template <typename AllocatorPolicy>
+class VectorStorage {
+private:
+    vector<PatientRef, typename AllocatorPolicy::template type<PatientRef>> items;
+
+    size_t indexOf(int id) const {
+        for (size_t i = 0; i < items.size(); ++i)
+            if (items[i]->id == id) return i;
+        return items.size();
+    }
+public:
+    static const char* name() { return "vector"; }
+    size_t size() const { return items.size(); }
+    size_t nodeBytes() const { return items.capacity() * sizeof(PatientRef); }
+    const Patient* find(int id) const {
+        size_t i = indexOf(id);
+        return i < items.size() ? items[i].get() : nullptr;
+    }
+    void insert(PatientRef p) { items.push_back(std::move(p)); }
+    bool erase(int id) {
+        size_t i = indexOf(id);
+        if (i == items.size()) return false;
+        items.erase(items.begin() + i);
+        return true;
+    }
+    bool replace(PatientRef p) {
+        size_t i = indexOf(p->id);
+        if (i == items.size()) return false;
+        items[i] = std::move(p);
+        return true;
     }
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& p : items) fn(*p);
+    }
+    void clear() { items.clear(); }
 };
 
-class EmergencyManager {
+template <typename AllocatorPolicy>
+class HashStorage {
 private:
-    priority_queue<EmergencyItem, vector<EmergencyItem>, EmergencyCompare> emergencyQueue;
+    typedef typename AllocatorPolicy::template type<pair<const int, PatientRef>> Alloc;
+    unordered_map<int, PatientRef, hash<int>, equal_to<int>, Alloc> items;
 public:
-    EmergencyManager() {}
-
-    void scheduleEmergency(const EmergencyItem& e) { emergencyQueue.push(e); }
-    bool hasEmergency() const { return !emergencyQueue.empty(); }
-    EmergencyItem popNextEmergency() {
-        if (emergencyQueue.empty()) return EmergencyItem();
-        EmergencyItem e = emergencyQueue.top();
-        emergencyQueue.pop();
-        return e;
+    static const char* name() { return "hash"; }
+    size_t size() const { return items.size(); }
+    size_t nodeBytes() const {
+        return items.bucket_count() * sizeof(void*) + items.size() * (sizeof(pair<const int, PatientRef>) + sizeof(void*));
+    }
+    const Patient* find(int id) const {
+        auto it = items.find(id);
+        return it == items.end() ? nullptr : it->second.get();
+    }
+    void insert(PatientRef p) {
+        int id = p->id;
+        items.emplace(id, std::move(p));
+    }
+    bool erase(int id) { return items.erase(id) > 0; }
+    bool replace(PatientRef p) {
+        auto it = items.find(p->id);
+        if (it == items.end()) return false;
+        it->second = std::move(p);
+        return true;
+    }
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& kv : items) fn(*kv.second);
     }
+    void clear() { items.clear(); }
+};
 
-    // linear search for patientId in emergency queue (inefficient but requested)
-    bool linearSearchPatient(int pid) const {
-        // priority_queue doesn't allow iteration; copy it
-        auto copy = emergencyQueue;
-        while (!copy.empty()) {
-            if (copy.top().patientId == pid) return true;
-            copy.pop();
+// B+ tree keyed by id: records live in linked leaves, inner nodes only route.
+// Erase does not rebalance (nodes may underfill until the next copy, which
+// bulk-builds the tree with every node filled to ORDER - 1 keys).
+template <typename AllocatorPolicy>
+class BTreeStorage {
+private:
+    static const int ORDER = 32;            // keys per node before a split
+    struct Node {
+        bool leaf;
+        int n;
+        int keys[ORDER];
+        PatientRef vals[ORDER];             // leaves
+        Node* child[ORDER + 1];             // inner nodes
+        Node* next;                         // next leaf in id order
+        explicit Node(bool isLeaf) : leaf(isLeaf), n(0), next(nullptr) {}
+    };
+    typedef typename AllocatorPolicy::template type<Node> Alloc;
+    Node* root;
+    size_t count;
+    size_t nodeCount;
+    Alloc alloc;
+
+    Node* make(bool leaf) {
+        Node* node = alloc.allocate(1);
+        ++nodeCount;
+        return new (node) Node(leaf);
+    }
+    void destroy(Node* node) {
+        if (!node->leaf)
+            for (int i = 0; i <= node->n; ++i) destroy(node->child[i]);
+        node->~Node();
+        alloc.deallocate(node, 1);
+        --nodeCount;
+    }
+    Node* leafFor(int id) const {
+        Node* node = root;
+        while (node && !node->leaf) node = node->child[upper_bound(node->keys, node->keys + node->n, id) - node->keys];
+        return node;
+    }
+    int slotIn(const Node* leaf, int id) const {
+        int i = (int)(lower_bound(leaf->keys, leaf->keys + leaf->n, id) - leaf->keys);
+        return i < leaf->n && leaf->keys[i] == id ? i : -1;
+    }
+    // Inserts into the subtree; returns the new right sibling if node split,
+    // with sep set to the first id routed to it.
+    Node* insertInto(Node* node, PatientRef& p, int& sep) {
+        int id = p->id;
+        if (node->leaf) {
+            int i = (int)(lower_bound(node->keys, node->keys + node->n, id) - node->keys);
+            for (int j = node->n; j > i; --j) {
+                node->keys[j] = node->keys[j - 1];
+                node->vals[j] = std::move(node->vals[j - 1]);
+            }
+            node->keys[i] = id;
+            node->vals[i] = std::move(p);
+            if (++node->n < ORDER) return nullptr;
+            Node* right = make(true);
+            int half = ORDER / 2;
+            for (int j = half; j < ORDER; ++j) {
+                right->keys[j - half] = node->keys[j];
+                right->vals[j - half] = std::move(node->vals[j]);
+            }
+            right->n = ORDER - half;
+            node->n = half;
+            right->next = node->next;
+            node->next = right;
+            sep = right->keys[0];
+            return right;
         }
-        return false;
+        int i = (int)(upper_bound(node->keys, node->keys + node->n, id) - node->keys);
+        int childSep;
+        Node* split = insertInto(node->child[i], p, childSep);
+        if (!split) return nullptr;
+        for (int j = node->n; j > i; --j) {
+            node->keys[j] = node->keys[j - 1];
+            node->child[j + 1] = node->child[j];
+        }
+        node->keys[i] = childSep;
+        node->child[i + 1] = split;
+        if (++node->n < ORDER) return nullptr;
+        Node* right = make(false);
+        int mid = ORDER / 2;
+        sep = node->keys[mid];
+        for (int j = mid + 1; j < ORDER; ++j) right->keys[j - mid - 1] = node->keys[j];
+        for (int j = mid + 1; j <= ORDER; ++j) right->child[j - mid - 1] = node->child[j];
+        right->n = ORDER - mid - 1;
+        node->n = mid;
+        return right;
     }
+public:
+    static const char* name() { return "btree"; }
+    BTreeStorage() : root(nullptr), count(0), nodeCount(0) {}
+    // Built bottom-up from o's records in id order rather than by repeated
+    // insertion, whose half-splits would leave nodes about half full.
+    BTreeStorage(const BTreeStorage& o) : root(nullptr), count(0), nodeCount(0) {
+        vector<const PatientRef*> refs;
+        refs.reserve(o.count);
+        o.forEachRef([&](const PatientRef& p) { refs.push_back(&p); });
+        if (refs.empty()) return;
+        vector<pair<Node*, int>> level;     // node, smallest id below it
+        size_t groups = (refs.size() + ORDER - 2) / (ORDER - 1);
+        Node* prev = nullptr;
+        for (size_t g = 0, pos = 0; g < groups; ++g) {
+            size_t take = (refs.size() - pos) / (groups - g);  // spread evenly
+            Node* leaf = make(true);
+            for (size_t j = 0; j < take; ++j, ++pos) {
+                leaf->keys[j] = (*refs[pos])->id;
+                leaf->vals[j] = *refs[pos];
+            }
+            leaf->n = (int)take;
+            if (prev) prev->next = leaf;
+            prev = leaf;
+            level.push_back({ leaf, leaf->keys[0] });
+        }
+        while (level.size() > 1) {
+            vector<pair<Node*, int>> up;
+            groups = (level.size() + ORDER - 1) / ORDER;
+            for (size_t g = 0, pos = 0; g < groups; ++g) {
+                size_t take = (level.size() - pos) / (groups - g);
+                Node* node = make(false);
+                up.push_back({ node, level[pos].second });
+                for (size_t j = 0; j < take; ++j, ++pos) {
+                    node->child[j] = level[pos].first;
+                    if (j > 0) node->keys[j - 1] = level[pos].second;
+                }
+                node->n = (int)take - 1;
+            }
+            level.swap(up);
+        }
+        root = level[0].first;
+        count = refs.size();
+    }
+    BTreeStorage& operator=(const BTreeStorage&) = delete;
+    ~BTreeStorage() { clear(); }
 
-    bool saveToFile(const string& filename = "emergencies.txt") const {
-        ofstream fout(filename);
-        if (!fout.is_open()) return false;
-        auto copy = emergencyQueue;
-        while (!copy.empty()) {
-            fout << copy.top().serialize() << '\n';
-            copy.pop();
+    size_t size() const { return count; }
+    size_t nodeBytes() const { return nodeCount * sizeof(Node); }
+    const Patient* find(int id) const {
+        Node* leaf = leafFor(id);
+        int i = leaf ? slotIn(leaf, id) : -1;
+        return i < 0 ? nullptr : leaf->vals[i].get();
+    }
+    void insert(PatientRef p) {
+        if (!root) root = make(true);
+        int sep;
+        Node* split = insertInto(root, p, sep);
+        if (split) {
+            Node* top = make(false);
+            top->n = 1;
+            top->keys[0] = sep;
+            top->child[0] = root;
+            top->child[1] = split;
+            root = top;
         }
-        fout.close();
+        ++count;
+    }
+    bool erase(int id) {
+        Node* leaf = leafFor(id);
+        int i = leaf ? slotIn(leaf, id) : -1;
+        if (i < 0) return false;
+        for (int j = i; j + 1 < leaf->n; ++j) {
+            leaf->keys[j] = leaf->keys[j + 1];
+            leaf->vals[j] = std::move(leaf->vals[j + 1]);
+        }
+        leaf->vals[--leaf->n].reset();
+        --count;
+        return true;
+    }
+    bool replace(PatientRef p) {
+        Node* leaf = leafFor(p->id);
+        int i = leaf ? slotIn(leaf, p->id) : -1;
+        if (i < 0) return false;
+        leaf->vals[i] = std::move(p);
         return true;
     }
+    template <typename Fn>
+    void forEachRef(Fn fn) const {
+        Node* node = root;
+        while (node && !node->leaf) node = node->child[0];
+        for (; node; node = node->next)
+            for (int i = 0; i < node->n; ++i) fn(node->vals[i]);
+    }
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        forEachRef([&](const PatientRef& p) { fn(*p); });
+    }
+    void clear() {
+        if (root) destroy(root);
+        root = nullptr;
+        count = 0;
+    }
+};
 
-    bool loadFromFile(const string& filename = "emergencies.txt") {
-        ifstream fin(filename);
-        if (!fin.is_open()) return false;
-        emergencyQueue = priority_queue<EmergencyItem, vector<EmergencyItem>, EmergencyCompare>();
-        string line;
-        while (getline(fin, line)) {
-            EmergencyItem e;
-            if (EmergencyItem::deserialize(line, e)) emergencyQueue.push(e);
+// Index policies. Hooks run after every storage change; find answers from
+// the index or falls through to the storage.
+struct NoIndex {
+    static const char* name() { return "none"; }
+    size_t bytes() const { return 0; }
+    template <typename S> const Patient* find(const S& s, int id) const { return s.find(id); }
+    template <typename S> void added(const S&, const Patient&) {}
+    void removed(int) {}
+    void replaced(const Patient&) {}
+    template <typename S> void rebuild(const S&) {}
+    void clear() {}
+    // The filter saved next to a shard file, built from the records.
+    template <typename S> IdBloomFilter filter(const S& s) const {
+        IdBloomFilter f((int)s.size() * 2);
+        s.forEach([&](const Patient& p) { f.add(p.id); });
+        return f;
+    }
+};
+
+// Rejects most unknown ids before the storage is searched. Removals leave
+// bits set; the filter is resized as the shard grows.
+struct BloomIndex {
+    IdBloomFilter bloom;
+    static const char* name() { return "bloom"; }
+    size_t bytes() const { return bloom.bytes(); }
+    template <typename S> const Patient* find(const S& s, int id) const {
+        return bloom.mightContain(id) ? s.find(id) : nullptr;
+    }
+    template <typename S> void added(const S& s, const Patient& p) {
+        if ((int)s.size() > bloom.capacityHint()) rebuild(s);
+        else bloom.add(p.id);
+    }
+    void removed(int) {}
+    void replaced(const Patient&) {}
+    template <typename S> void rebuild(const S& s) {
+        bloom.reset((int)s.size() * 2);
+        s.forEach([&](const Patient& p) { bloom.add(p.id); });
+    }
+    void clear() { bloom.reset(0); }
+    template <typename S> IdBloomFilter filter(const S&) const { return bloom; }
+};
+
+// id -> record pointer. Records are immutable and shared, so the pointers
+// stay valid for as long as the version holding them.
+struct HashIndex {
+    unordered_map<int, const Patient*> byId;
+    static const char* name() { return "hash"; }
+    size_t bytes() const {
+        return byId.bucket_count() * sizeof(void*) + byId.size() * (sizeof(pair<const int, const Patient*>) + sizeof(void*));
+    }
+    template <typename S> const Patient* find(const S&, int id) const {
+        auto it = byId.find(id);
+        return it == byId.end() ? nullptr : it->second;
+    }
+    template <typename S> void added(const S&, const Patient& p) { byId[p.id] = &p; }
+    void removed(int id) { byId.erase(id); }
+    void replaced(const Patient& p) { byId[p.id] = &p; }
+    template <typename S> void rebuild(const S& s) {
+        byId.clear();
+        byId.reserve(s.size());
+        s.forEach([&](const Patient& p) { byId[p.id] = &p; });
+    }
+    void clear() { byId.clear(); }
+    template <typename S> IdBloomFilter filter(const S& s) const { return NoIndex().filter(s); }
+};
+
+// Frozen, read-only view of a store. Taking one is O(1); it stays valid and
+// unchanged while the store keeps being edited. A snapshot of a sharded
+// store holds one version per shard.
+template <typename Version>
+class BasicPatientSnapshot {
+private:
+    vector<shared_ptr<const Version>> parts;
+    int count;
+    unsigned long long ver;
+public:
+    BasicPatientSnapshot() : count(0), ver(0) {}
+    BasicPatientSnapshot(shared_ptr<const Version> v, unsigned long long version)
+        : count((int)v->records.size()), ver(version) {
+        parts.push_back(std::move(v));
+    }
+
+    // Appends another snapshot's versions (used to combine shard snapshots).
+    void append(const BasicPatientSnapshot& other) {
+        parts.insert(parts.end(), other.parts.begin(), other.parts.end());
+        count += other.count;
+        ver += other.ver;
+    }
+
+    bool empty() const { return count == 0; }
+    int size() const { return count; }
+    unsigned long long version() const { return ver; }
+
+    const Patient* findById(int id) const {
+        for (const auto& v : parts)
+            if (const Patient* p = v->find(id)) return p;
+        return nullptr;
+    }
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& v : parts) v->records.forEach(fn);
+    }
+
+    vector<Patient> toVector() const {
+        vector<Patient> v;
+        v.reserve(count);
+        forEach([&](const Patient& p) { v.push_back(p); });
+        return v;
+    }
+
+    bool saveToFile(const string& filename = "patients.txt", StorageFormat fmt = StorageFormat::Text) const {
+        if (fmt == StorageFormat::Packed) {
+            PackedWriter<PatientCodec> w(filename);
+            if (!w.isOpen()) return false;
+            forEach([&](const Patient& p) { w.add(p); });
+            return w.finish();
         }
-        fin.close();
+        ofstream fout(filename);
+        if (!fout.is_open()) return false;
+        forEach([&](const Patient& p) { fout << p.serialize() << '\n'; });
+        fout.close();
         return true;
     }
 };
 
-// ---------------------------- Doctor / Staff DB (Hash Table) -------------
-class DoctorDB {
+template <template <typename> class StoragePolicy, typename IndexPolicy, typename AllocatorPolicy>
+class PatientStore {
+public:
+    typedef StoragePolicy<AllocatorPolicy> Storage;
+    // One version of the store. A version is never modified once a snapshot
+    // holds it; writers copy it first (copy-on-write).
+    struct Version {
+        Storage records;
+        IndexPolicy index;
+        const Patient* find(int id) const { return index.find(records, id); }
+    };
+    typedef BasicPatientSnapshot<Version> Snapshot;
+
 private:
-    // doctorName -> vector of available time slots
-    unordered_map<string, vector<string>> doctors;
-    // staffName -> role
-    unordered_map<string, string> staff; // e.g., "Nurse A" -> "nurse"
+    shared_ptr<Version> cur;
+    unsigned long long ver;     // bumped on every write
+    mutable mutex mtx;
+
+    static PatientRef makeRef(const Patient& p) {
+        return allocate_shared<Patient>(typename AllocatorPolicy::template type<Patient>(), p);
+    }
+
+    // Called with mtx held before any write: if a snapshot still references
+    // the current version, give the writer its own copy.
+    Version& writable() {
+        if (cur.use_count() > 1) cur = make_shared<Version>(*cur);
+        ++ver;
+        return *cur;
+    }
+
+    const Patient* findLocked(int id) const { return cur->find(id); }
+
+    void insertLocked(Version& v, const Patient& p) {
+        PatientRef ref = makeRef(p);
+        const Patient& rec = *ref;
+        v.records.insert(std::move(ref));
+        v.index.added(v.records, rec);
+    }
+
+    bool addLocked(const Patient& p) {
+        if (findLocked(p.id) != nullptr) return false; // duplicate id
+        insertLocked(writable(), p);
+        return true;
+    }
+
+    void addBatchLocked(const vector<Patient>& v, vector<char>& added) {
+        added.assign(v.size(), 0);
+        if (v.empty()) return;
+        Version& w = writable();
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (findLocked(v[i].id) != nullptr) continue;
+            insertLocked(w, v[i]);
+            added[i] = 1;
+        }
+    }
 
+    void clearLocked() {
+        cur = make_shared<Version>();
+        ++ver;
+    }
 public:
-    DoctorDB() {}
+    PatientStore() : cur(make_shared<Version>()), ver(0) {}
+    PatientStore(const PatientStore&) = delete;
+    PatientStore& operator=(const PatientStore&) = delete;
 
-    void addDoctor(const string& name) {
-        if (doctors.find(name) == doctors.end()) doctors[name] = vector<string>();
+    // e.g. "list/bloom/std"
+    static string describe() {
+        return string(Storage::name()) + '/' + IndexPolicy::name() + '/' + AllocatorPolicy::name();
     }
 
-    bool removeDoctor(const string& name) {
-        auto it = doctors.find(name);
-        if (it == doctors.end()) return false;
-        doctors.erase(it);
+    bool empty() const { lock_guard<mutex> lk(mtx); return cur->records.size() == 0; }
+    int size() const { lock_guard<mutex> lk(mtx); return (int)cur->records.size(); }
+    unsigned long long version() const { lock_guard<mutex> lk(mtx); return ver; }
+    IdBloomFilter idFilter() const { lock_guard<mutex> lk(mtx); return cur->index.filter(cur->records); }
+
+    // Bytes of the current version (versions kept alive only by snapshots
+    // are not counted). O(n): walks every record's strings.
+    MemoryUsage memoryUsage() const {
+        lock_guard<mutex> lk(mtx);
+        MemoryUsage u;
+        cur->records.forEach([&](const Patient& p) { u += recordUsage(p); });
+        u.nodes = cur->records.nodeBytes();
+        u.index = cur->index.bytes();
+        return u;
+    }
+
+    Snapshot snapshot() const {
+        lock_guard<mutex> lk(mtx);
+        return Snapshot(cur, ver);
+    }
+
+    bool addPatient(const Patient& p) {
+        lock_guard<mutex> lk(mtx);
+        return addLocked(p);
+    }
+
+    // Adds many records under one lock and one copy-on-write check. added[i]
+    // is set to 0 for duplicate ids (already present or repeated in batch).
+    void addBatch(const vector<Patient>& v, vector<char>& added) {
+        lock_guard<mutex> lk(mtx);
+        addBatchLocked(v, added);
+    }
+
+    bool removeById(int id) {
+        lock_guard<mutex> lk(mtx);
+        if (!findLocked(id)) return false;
+        Version& v = writable();
+        v.records.erase(id);
+        v.index.removed(id);
         return true;
     }
 
-    bool addAvailability(const string& name, const string& timeslot) {
-        auto it = doctors.find(name);
-        if (it == doctors.end()) return false;
-        it->second.push_back(timeslot);
+    // Replaces the record with the same id. Readers holding a snapshot keep
+    // seeing the old record.
+    bool updatePatient(const Patient& p) {
+        lock_guard<mutex> lk(mtx);
+        if (!findLocked(p.id)) return false;
+        Version& v = writable();
+        PatientRef ref = makeRef(p);
+        const Patient& rec = *ref;
+        v.records.replace(std::move(ref));
+        v.index.replaced(rec);
         return true;
     }
 
-    bool removeAvailability(const string& name, const string& timeslot) {
-        auto it = doctors.find(name);
-        if (it == doctors.end()) return false;
-        auto& vec = it->second;
-        auto f = find(vec.begin(), vec.end(), timeslot);
-        if (f == vec.end()) return false;
-        vec.erase(f);
+    // The pointer stays valid until the next write to the store; take a
+    // snapshot to keep reading across writes.
+    const Patient* findById(int id) const {
+        lock_guard<mutex> lk(mtx);
+        return findLocked(id);
+    }
+
+    // Copies the record out under the lock; safe while other threads write.
+    bool getById(int id, Patient& out) const {
+        lock_guard<mutex> lk(mtx);
+        const Patient* p = findLocked(id);
+        if (!p) return false;
+        out = *p;
         return true;
     }
 
-    vector<pair<string, vector<string>>> listAllDoctors() const {
-        vector<pair<string, vector<string>>> out;
-        for (const auto& kv : doctors) out.push_back(kv);
-        return out;
+    vector<Patient> toVector() const { return snapshot().toVector(); }
+
+    void replaceFromVector(const vector<Patient>& v) {
+        lock_guard<mutex> lk(mtx);
+        clearLocked();
+        for (const auto& p : v) addLocked(p);
+    }
+
+    // O(n) replacement for input whose ids are already unique (e.g. the
+    // output of an id merge); skips the per-record duplicate check.
+    void bulkLoadUnique(const vector<Patient>& v) {
+        lock_guard<mutex> lk(mtx);
+        clearLocked();
+        Version& w = writable();
+        for (const auto& p : v) w.records.insert(makeRef(p));
+        w.index.rebuild(w.records);
+    }
+
+    void displayAll() const {
+        Snapshot snap = snapshot();
+        if (snap.empty()) {
+            cout << "No patient records.\n";
+            return;
+        }
+        cout << left << setw(6) << "ID" << setw(20) << "Name" << setw(6) << "Age"
+            << setw(8) << "Gender" << setw(15) << "Ailment" << setw(9) << "Priority"
+            << setw(15) << "Doctor" << setw(12) << "Phone" << '\n';
+        cout << string(95, '-') << '\n';
+        snap.forEach([](const Patient& p) {
+            cout << setw(6) << p.id << setw(20) << p.name << setw(6) << p.age
+                << setw(8) << p.gender << setw(15) << p.ailment << setw(9) << p.priority
+                << setw(15) << p.assignedDoctor << setw(12) << p.phone << '\n';
+        });
+    }
+
+    // Writes a frozen version, so edits are not blocked while the file is written.
+    bool saveToFile(const string& filename = "patients.txt", StorageFormat fmt = StorageFormat::Text) const {
+        return snapshot().saveToFile(filename, fmt);
+    }
+
+    // Reads either format. A packed file with a damaged block is rejected
+    // as a whole and the store is left as it was. Text lines that do not
+    // parse are skipped and counted in *rejected.
+    bool loadFromFile(const string& filename = "patients.txt", size_t* rejected = nullptr) {
+        if (isPackedFile(filename)) {
+            PackedReader<PatientCodec> r(filename);
+            vector<Patient> all, block;
+            while (r.nextBlock(block)) all.insert(all.end(), block.begin(), block.end());
+            if (!r.ok()) return false;
+            vector<char> added;
+            lock_guard<mutex> lk(mtx);
+            clearLocked();
+            addBatchLocked(all, added);
+            return true;
+        }
+        ifstream fin(filename);
+        if (!fin.is_open()) return false;
+        lock_guard<mutex> lk(mtx);
+        clearLocked();
+        string line;
+        while (getline(fin, line)) {
+            Patient p;
+            if (Patient::deserialize(line, p)) addLocked(p);
+            else if (rejected && !line.empty() && line != "\r") ++*rejected;
+        }
+        bool readOk = !fin.bad();
+        fin.close();
+        return readOk;
+    }
+
+    void clear() {
+        lock_guard<mutex> lk(mtx);
+        clearLocked();
+    }
+};
+
+// The original linked list with its id filter.
+typedef PatientStore<ListStorage, BloomIndex, StdAllocPolicy> PatientList;
+
+// Backend used by every shard, chosen per build, e.g.
+//   cmake -DHOSPITAL_PATIENT_STORAGE=BTreeStorage -DHOSPITAL_PATIENT_ALLOCATOR=PoolAllocPolicy
+#ifndef HOSPITAL_PATIENT_STORAGE
+#define HOSPITAL_PATIENT_STORAGE ListStorage
+#endif
+#ifndef HOSPITAL_PATIENT_INDEX
+#define HOSPITAL_PATIENT_INDEX BloomIndex
+#endif
+#ifndef HOSPITAL_PATIENT_ALLOCATOR
+#define HOSPITAL_PATIENT_ALLOCATOR StdAllocPolicy
+#endif
+typedef PatientStore<HOSPITAL_PATIENT_STORAGE, HOSPITAL_PATIENT_INDEX, HOSPITAL_PATIENT_ALLOCATOR> PatientBackend;
+typedef PatientBackend::Snapshot PatientSnapshot;
+
+// ---------------------------- Ailment Trend Sketches ---------------------
+// Constant-memory, real-time view of which ailments are arriving now. Time
+// is cut into buckets (1 minute by default) kept in a ring covering the last
+// two hours. Each bucket holds
+//   - a count-min sketch: estimates any ailment's count, never under and
+//     over by at most ~1% of the bucket's total
+//   - a Space-Saving summary of 32 counters: the bucket's heavy hitters
+// A window query adds up its buckets' sketches and ranks the union of their
+// heavy hitters by the merged estimate (capped by the summed Space-Saving
+// bounds), so memory and query cost do not grow with the number of patients.
+inline unsigned long long hashKey(const string& s) {
+    // FNV-1a, then the splitmix64 finalizer to spread the bits
+    unsigned long long z = 1469598103934665603ULL;
+    for (unsigned char c : s) z = (z ^ c) * 1099511628211ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+class CountMinSketch {
+public:
+    static const int DEPTH = 4;
+    static const int WIDTH = 256;
+private:
+    uint32_t cells[DEPTH][WIDTH];
+    static int column(unsigned long long h, int row) {
+        return (int)((h + (unsigned long long)row * ((h >> 32) | 1)) % WIDTH);
+    }
+public:
+    CountMinSketch() { clear(); }
+    void clear() { memset(cells, 0, sizeof(cells)); }
+    void add(unsigned long long h, uint32_t n = 1) {
+        for (int r = 0; r < DEPTH; ++r) cells[r][column(h, r)] += n;
+    }
+    uint32_t estimate(unsigned long long h) const {
+        uint32_t best = numeric_limits<uint32_t>::max();
+        for (int r = 0; r < DEPTH; ++r) best = min(best, cells[r][column(h, r)]);
+        return best;
+    }
+    void merge(const CountMinSketch& o) {
+        for (int r = 0; r < DEPTH; ++r)
+            for (int c = 0; c < WIDTH; ++c) cells[r][c] += o.cells[r][c];
+    }
+};
+
+// Keeps the k most frequent keys of a stream in k counters. A newcomer
+// replaces the smallest counter and inherits its count as possible error.
+class SpaceSaving {
+public:
+    struct Counter {
+        string key;
+        uint32_t count;
+        uint32_t error;
+    };
+private:
+    vector<Counter> counters;
+    size_t capacity;
+public:
+    explicit SpaceSaving(size_t k = 32) : capacity(max<size_t>(1, k)) {}
+    void clear() { counters.clear(); }
+    void add(const string& key) {
+        for (auto& c : counters) {
+            if (c.key == key) {
+                ++c.count;
+                return;
+            }
+        }
+        if (counters.size() < capacity) {
+            counters.push_back({ key, 1, 0 });
+            return;
+        }
+        auto smallest = min_element(counters.begin(), counters.end(),
+            [](const Counter& a, const Counter& b) { return a.count < b.count; });
+        smallest->key = key;
+        smallest->error = smallest->count;
+        ++smallest->count;
+    }
+    const vector<Counter>& items() const { return counters; }
+
+    // Upper bound on key's true count: its counter if monitored, otherwise
+    // the smallest counter once all k are taken (0 before that).
+    uint32_t upperBound(const string& key) const {
+        uint32_t smallest = numeric_limits<uint32_t>::max();
+        for (const auto& c : counters) {
+            if (c.key == key) return c.count;
+            smallest = min(smallest, c.count);
+        }
+        return counters.size() < capacity ? 0 : smallest;
+    }
+};
+
+struct AilmentTrend {
+    string ailment;
+    unsigned long long count;       // estimate in the window
+    unsigned long long previous;    // estimate in the window before it
+};
+
+// One event stream over a ring of time buckets.
+class TrendWindow {
+private:
+    struct Bucket {
+        long long epoch = -1;       // bucket number since the epoch (-1 = unused)
+        unsigned long long total = 0;
+        CountMinSketch cms;
+        SpaceSaving top;
+    };
+    vector<Bucket> ring;
+    long long bucketMs;
+
+    // Sums the buckets for epochs in (last - span, last].
+    void gather(long long last, long long span, CountMinSketch& cms, unsigned long long& total,
+        vector<const Bucket*>& used) const {
+        for (const auto& b : ring) {
+            if (b.epoch <= last - span || b.epoch > last) continue;
+            cms.merge(b.cms);
+            total += b.total;
+            used.push_back(&b);
+        }
+    }
+
+    static unsigned long long estimate(const string& key, const CountMinSketch& cms,
+        const vector<const Bucket*>& used) {
+        unsigned long long bound = 0;
+        for (const Bucket* b : used) bound += b->top.upperBound(key);
+        return min<unsigned long long>(cms.estimate(hashKey(key)), bound);
+    }
+public:
+    explicit TrendWindow(int buckets = 120, long long bucketMillis = 60000)
+        : ring(max(1, buckets)), bucketMs(max(1LL, bucketMillis)) {}
+
+    long long historyMs() const { return bucketMs * (long long)ring.size(); }
+
+    void record(const string& key, long long atMs) {
+        long long epoch = atMs / bucketMs;
+        Bucket& b = ring[(size_t)(epoch % (long long)ring.size())];
+        if (b.epoch != epoch) {
+            if (b.epoch > epoch) return;            // older than the history kept
+            b.epoch = epoch;
+            b.total = 0;
+            b.cms.clear();
+            b.top.clear();
+        }
+        b.cms.add(hashKey(key));
+        b.top.add(key);
+        ++b.total;
+    }
+
+    // Top k keys in the windowMs ending at nowMs (at most the history kept).
+    // previous is filled when the window before it is still in the ring.
+    vector<AilmentTrend> top(long long nowMs, long long windowMs, int k, unsigned long long& total) const {
+        long long last = nowMs / bucketMs;
+        long long span = min((long long)ring.size(), max(1LL, (windowMs + bucketMs - 1) / bucketMs));
+        CountMinSketch now, before;
+        vector<const Bucket*> used, usedBefore;
+        total = 0;
+        gather(last, span, now, total, used);
+        unsigned long long beforeTotal = 0;
+        bool hasBefore = 2 * span <= (long long)ring.size();
+        if (hasBefore) gather(last - span, span, before, beforeTotal, usedBefore);
+
+        set<string> candidates;
+        for (const Bucket* b : used)
+            for (const auto& c : b->top.items()) candidates.insert(c.key);
+        vector<AilmentTrend> out;
+        for (const auto& key : candidates)
+            out.push_back({ key, estimate(key, now, used), hasBefore ? estimate(key, before, usedBefore) : 0ULL });
+        size_t keep = min(out.size(), (size_t)max(0, k));
+        partial_sort(out.begin(), out.begin() + keep, out.end(), [](const AilmentTrend& a, const AilmentTrend& b) {
+            return a.count != b.count ? a.count > b.count : a.ailment < b.ailment;
+        });
+        out.resize(keep);
+        return out;
+    }
+};
+
+enum class TrendSource { Admissions, Emergencies };
+
+// Trend streams for new patients and new emergencies; safe from any thread.
+class AilmentTrends {
+private:
+    TrendWindow admissions;
+    TrendWindow emergencies;
+    mutable mutex mtx;
+public:
+    AilmentTrends(int buckets = 120, long long bucketMs = 60000)
+        : admissions(buckets, bucketMs), emergencies(buckets, bucketMs) {}
+
+    long long historyMs() const { return admissions.historyMs(); }
+
+    void record(TrendSource src, const string& ailment, long long atMs) {
+        if (ailment.empty()) return;
+        static LatencyHistogram& hist = opStats("trends.record");
+        ScopedTimer timer(hist);
+        lock_guard<mutex> lk(mtx);
+        (src == TrendSource::Admissions ? admissions : emergencies).record(ailment, atMs);
+    }
+
+    vector<AilmentTrend> top(TrendSource src, long long nowMs, long long windowMs, int k,
+        unsigned long long& total) const {
+        static LatencyHistogram& hist = opStats("trends.top");
+        ScopedTimer timer(hist);
+        lock_guard<mutex> lk(mtx);
+        return (src == TrendSource::Admissions ? admissions : emergencies).top(nowMs, windowMs, k, total);
+    }
+
+    void print(ostream& out, long long nowMs, long long windowMs, int k) const {
+        for (TrendSource src : { TrendSource::Admissions, TrendSource::Emergencies }) {
+            unsigned long long total = 0;
+            vector<AilmentTrend> t = top(src, nowMs, windowMs, k, total);
+            bool hasBefore = 2 * windowMs <= historyMs();
+            out << (src == TrendSource::Admissions ? "New patients" : "Emergencies") << " in the last "
+                << windowMs / 60000 << " min: " << total << '\n';
+            if (t.empty()) continue;
+            out << left << setw(20) << "  Ailment" << right << setw(10) << "Count"
+                << setw(12) << (hasBefore ? "Previous" : "") << '\n';
+            for (const auto& a : t) {
+                out << left << setw(20) << "  " + a.ailment << right << setw(10) << a.count;
+                if (hasBefore) out << setw(12) << a.previous;
+                out << '\n';
+            }
+            out << left;
+        }
+    }
+};
+
+// ---------------------------- Sharded Patient Store ----------------------
+// Patients are partitioned into fixed-width id ranges. Each shard has its own
+// PatientBackend store and file; a manifest maps ranges to files:
+//   patients.manifest : lo|hi|filename   (one line per shard)
+// Shards are loaded lazily on first access, so a lookup on a cold shard reads
+// only that shard's file. Each shard file has a companion .bloom id filter,
+// read with the manifest, so lookups of unknown ids skip the shard file. Full scans load missing shards in parallel, and
+// saves write only shards changed since they were last loaded/saved.
+// With a memory budget set, the loaded shards act as a cache over the shard
+// files: before a cold shard is loaded, a CLOCK hand drops resident shards
+// that have not been touched since it last passed and whose file is current,
+// and they fault back in on their next access. Shards with unsaved changes
+// are never dropped, so the budget can be exceeded until the next save.
+// A shard whose file exists but cannot be read is damaged: every add, find,
+// update and remove in its range fails (damagedShardFor tells why) and the
+// file is never overwritten, until it is repaired and the store reloaded.
+struct PatientShard {
+    int lo, hi;                 // inclusive id range
+    string file;
+    PatientBackend list;
+    bool loaded;
+    unsigned long long savedVersion;
+    IdBloomFilter coldFilter;   // valid while !loaded and hasColdFilter
+    bool hasColdFilter;
+    bool damaged;               // file unreadable or failed its checksum; never overwritten
+    bool packedOnDisk;          // format of the file as last read or written
+    bool referenced;            // CLOCK bit: set on access, cleared by the hand
+    size_t residentBytes;       // accounted while loaded (exact at load/save)
+    mutex loadMtx;              // guards loading, eviction and use of list
+    PatientShard(int l, int h, const string& f)
+        : lo(l), hi(h), file(f), loaded(false), savedVersion(0), hasColdFilter(false), damaged(false),
+          packedOnDisk(false), referenced(false), residentBytes(0) {}
+
+    string bloomFile() const {
+        size_t dot = file.rfind('.');
+        return (dot == string::npos ? file : file.substr(0, dot)) + ".bloom";
+    }
+};
+
+class ShardedPatientStore {
+private:
+    map<int, unique_ptr<PatientShard>> shards;   // keyed by lo
+    string manifestFile;
+    int shardWidth;
+    StorageFormat fileFormat;                    // format shards are written in
+    AilmentTrends* trends = nullptr;             // fed with each new patient
+    atomic<size_t> budgetBytes{ 0 };             // 0 = no limit
+    atomic<long long> residentBytes{ 0 };        // sum over loaded shards
+    atomic<unsigned long long> shardLoads{ 0 };
+    atomic<unsigned long long> evictions{ 0 };
+    size_t clockHand = 0;                        // guarded by evictMtx
+    mutex evictMtx;
+    mutable mutex mtx;                           // guards the shard table
+
+    int rangeStart(int id) const {
+        long long w = shardWidth;
+        long long q = (long long)id / w;
+        if ((long long)id % w < 0) --q;          // floor for negative ids
+        return (int)max<long long>(q * w, numeric_limits<int>::min());
+    }
+
+    // Returns the shard covering id, optionally creating it; never loads it.
+    PatientShard* shardFor(int id, bool create) {
+        lock_guard<mutex> lk(mtx);
+        int lo = rangeStart(id);
+        auto it = shards.find(lo);
+        if (it != shards.end()) return it->second.get();
+        if (!create) return nullptr;
+        int hi = (int)min<long long>((long long)lo + shardWidth - 1, numeric_limits<int>::max());
+        // shard files sit next to the manifest: patients.manifest -> patients_<lo>_<hi>.txt
+        size_t dot = manifestFile.rfind('.');
+        ostringstream name;
+        name << (dot == string::npos ? manifestFile : manifestFile.substr(0, dot)) << '_' << lo << '_' << hi << ".txt";
+        auto sh = make_unique<PatientShard>(lo, hi, name.str());
+        sh->loaded = true;                       // brand new, nothing on disk yet
+        PatientShard* raw = sh.get();
+        shards[lo] = std::move(sh);
+        return raw;
+    }
+
+    // Call with sh.loadMtx held. Loads a cold shard (making room first
+    // unless a full scan is under way) and marks the shard as in use.
+    void loadLocked(PatientShard& sh, bool makeRoomFirst = true) {
+        sh.referenced = true;
+        if (sh.loaded) return;
+        if (makeRoomFirst) makeRoom(&sh);
+        static LatencyHistogram& hist = opStats("patients.shardLoad");
+        ScopedTimer timer(hist);
+        // a missing file is an empty shard; one that exists but cannot be
+        // opened or fully parsed is kept on disk for repair
+        sh.packedOnDisk = isPackedFile(sh.file);
+        size_t rejected = 0;
+        errno = 0;
+        bool read = sh.list.loadFromFile(sh.file, &rejected);
+        if ((!read && (sh.packedOnDisk || errno != ENOENT)) || rejected > 0) {
+            sh.damaged = true;
+            sh.list.clear();
+        }
+        sh.savedVersion = sh.list.version();
+        sh.loaded = true;
+        sh.hasColdFilter = false;
+        recount(sh);
+        ++shardLoads;
+    }
+
+    // Call with sh.loadMtx held: per-record estimate for a write, exact
+    // again at the shard's next recount.
+    void adjustResident(PatientShard& sh, long long delta) {
+        delta = max(delta, -(long long)sh.residentBytes);
+        sh.residentBytes = (size_t)((long long)sh.residentBytes + delta);
+        residentBytes += delta;
+    }
+
+    // Call with sh.loadMtx held: exact accounting of a loaded shard.
+    void recount(PatientShard& sh) {
+        size_t bytes = sh.list.memoryUsage().total();
+        residentBytes += (long long)bytes - (long long)sh.residentBytes;
+        sh.residentBytes = bytes;
+    }
+
+    // Runs fn(shard) with the shard loaded and locked against eviction. A
+    // damaged shard is refused: fn is skipped and a default result returned.
+    template <typename Fn>
+    auto withShard(PatientShard& sh, Fn fn) -> decltype(fn(sh)) {
+        lock_guard<mutex> lk(sh.loadMtx);
+        loadLocked(sh);
+        if (sh.damaged) return decltype(fn(sh))();
+        return fn(sh);
+    }
+
+    // Same, unless the shard is cold and its filter proves id is not in it.
+    template <typename Fn>
+    bool withShardIfMayContain(PatientShard& sh, int id, Fn fn) {
+        lock_guard<mutex> lk(sh.loadMtx);
+        if (!sh.loaded && sh.hasColdFilter && !sh.coldFilter.mightContain(id)) return false;
+        loadLocked(sh);
+        return !sh.damaged && fn(sh);
+    }
+
+    // Call with sh.loadMtx held. Only a shard whose file holds exactly its
+    // records, in the current write format, may be dropped.
+    bool evictable(PatientShard& sh) const {
+        return sh.loaded && !sh.damaged && sh.list.version() == sh.savedVersion
+            && sh.packedOnDisk == (fileFormat == StorageFormat::Packed);
+    }
+
+    // Call with sh.loadMtx held. Keeps the id filter for cold lookups.
+    void evictLocked(PatientShard& sh) {
+        sh.coldFilter = sh.list.idFilter();
+        sh.hasColdFilter = true;
+        sh.list.clear();
+        sh.loaded = false;
+        residentBytes -= (long long)sh.residentBytes;
+        sh.residentBytes = 0;
+        ++evictions;
+    }
+
+    // CLOCK sweep until resident shards fit the budget: a shard touched
+    // since the hand last passed gets a second chance. keep (the shard about
+    // to be used, whose lock the caller holds) is skipped, as are shards
+    // busy in another thread.
+    void makeRoom(PatientShard* keep) {
+        if (budgetBytes == 0 || residentBytes.load() <= (long long)budgetBytes) return;
+        static LatencyHistogram& hist = opStats("patients.evict");
+        ScopedTimer timer(hist);
+        lock_guard<mutex> ek(evictMtx);
+        vector<PatientShard*> v = allShards();
+        for (size_t step = 0; step < 2 * v.size() && residentBytes.load() > (long long)budgetBytes; ++step) {
+            PatientShard* sh = v[clockHand++ % v.size()];
+            if (sh == keep) continue;
+            unique_lock<mutex> lk(sh->loadMtx, try_to_lock);
+            if (!lk.owns_lock() || !sh->loaded) continue;
+            if (sh->referenced) {
+                sh->referenced = false;
+                continue;
+            }
+            if (evictable(*sh)) evictLocked(*sh);
+        }
+    }
+
+    vector<PatientShard*> allShards() const {
+        lock_guard<mutex> lk(mtx);
+        vector<PatientShard*> v;
+        for (const auto& kv : shards) v.push_back(kv.second.get());
+        return v;
+    }
+
+    bool saveManifest() const {
+        ofstream fout(manifestFile);
+        if (!fout.is_open()) return false;
+        for (PatientShard* sh : allShards()) fout << sh->lo << '|' << sh->hi << '|' << sh->file << '\n';
+        fout.close();
+        return true;
+    }
+
+public:
+    ShardedPatientStore(const string& manifest = "patients.manifest", int width = 10000)
+        : manifestFile(manifest), shardWidth(max(1, width)), fileFormat(StorageFormat::Text) {}
+    ShardedPatientStore(const ShardedPatientStore&) = delete;
+    ShardedPatientStore& operator=(const ShardedPatientStore&) = delete;
+
+    int shardCount() const { lock_guard<mutex> lk(mtx); return (int)shards.size(); }
+
+    // True (with the file named) when id falls in a damaged shard, i.e. a
+    // failed operation on id was refused rather than a missing/duplicate id.
+    bool damagedShardFor(int id, string& file) {
+        PatientShard* sh = shardFor(id, false);
+        if (!sh) return false;
+        lock_guard<mutex> lk(sh->loadMtx);
+        if (!sh->damaged) return false;
+        file = sh->file;
+        return true;
+    }
+
+    // Files of the shards found damaged so far (shards are checked as they load).
+    vector<string> damagedShardFiles() const {
+        vector<string> v;
+        for (PatientShard* sh : allShards()) {
+            lock_guard<mutex> lk(sh->loadMtx);
+            if (sh->damaged) v.push_back(sh->file);
+        }
+        return v;
+    }
+
+    // Shards are read in whichever format they are in; loading a manifest
+    // adopts the format of its shard files. Setting the write format loads
+    // every shard, so the next save converts any file still in the other one.
+    StorageFormat format() const { return fileFormat; }
+    void setFormat(StorageFormat f) {
+        fileFormat = f;
+        loadAll();
+    }
+
+    // On-disk shard files in id order (what streaming reports read).
+    vector<string> shardFiles() const {
+        vector<string> v;
+        for (PatientShard* sh : allShards()) v.push_back(sh->file);
+        return v;
+    }
+    int loadedShardCount() const {
+        int n = 0;
+        for (PatientShard* sh : allShards()) {
+            lock_guard<mutex> lk(sh->loadMtx);
+            if (sh->loaded) ++n;
+        }
+        return n;
+    }
+
+    // Loads every cold shard, in parallel. A full scan needs every shard, so
+    // the budget is not enforced here; the next cold load restores it.
+    void loadAll() {
+        vector<PatientShard*> v = allShards();
+        parallelFor((int)v.size(), [&](int i) {
+            lock_guard<mutex> lk(v[i]->loadMtx);
+            loadLocked(*v[i], false);
+        });
+    }
+
+    bool addPatient(const Patient& p) {
+        static LatencyHistogram& hist = opStats("patients.addPatient");
+        ScopedTimer timer(hist);
+        PatientShard* sh = shardFor(p.id, true);
+        bool added = withShard(*sh, [&](PatientShard& s) {
+            if (!s.list.addPatient(p)) return false;
+            adjustResident(s, (long long)recordUsage(p).total());
+            return true;
+        });
+        if (!added) return false;
+        if (trends) trends->record(TrendSource::Admissions, p.ailment, nowMillis());
+        return true;
+    }
+
+    // Bulk insert: records are grouped by shard and each shard is filled
+    // with one PatientBackend::addBatch call, shards in parallel.
+    void addBatch(const vector<Patient>& v, vector<char>& added) {
+        static LatencyHistogram& hist = opStats("patients.addBatch");
+        ScopedTimer timer(hist);
+        insertBatch(v, added);
+        if (!trends) return;
+        long long now = nowMillis();
+        for (size_t i = 0; i < v.size(); ++i)
+            if (added[i]) trends->record(TrendSource::Admissions, v[i].ailment, now);
+    }
+
+    // Trend sketches fed by addPatient/addBatch (loads and imports are not
+    // arrivals and bypass them). nullptr detaches.
+    void attachTrends(AilmentTrends* t) { trends = t; }
+    AilmentTrends* trendSink() const { return trends; }
+
+private:
+    void insertBatch(const vector<Patient>& v, vector<char>& added) {
+        added.assign(v.size(), 0);
+        map<PatientShard*, vector<size_t>> groups;
+        for (size_t i = 0; i < v.size(); ++i) groups[shardFor(v[i].id, true)].push_back(i);
+        vector<pair<PatientShard*, vector<size_t>>> work(groups.begin(), groups.end());
+        parallelFor((int)work.size(), [&](int w) {
+            vector<Patient> part;
+            part.reserve(work[w].second.size());
+            for (size_t i : work[w].second) part.push_back(v[i]);
+            vector<char> ok;
+            withShard(*work[w].first, [&](PatientShard& sh) {
+                sh.list.addBatch(part, ok);
+                size_t bytes = 0;
+                for (size_t k = 0; k < ok.size(); ++k)
+                    if (ok[k]) bytes += recordUsage(part[k]).total();
+                adjustResident(sh, (long long)bytes);
+            });
+            for (size_t k = 0; k < ok.size(); ++k) added[work[w].second[k]] = ok[k];
+        });
+    }
+
+public:
+
+    bool removeById(int id) {
+        static LatencyHistogram& hist = opStats("patients.removeById");
+        ScopedTimer timer(hist);
+        PatientShard* sh = shardFor(id, false);
+        return sh && withShardIfMayContain(*sh, id, [&](PatientShard& s) {
+            const Patient* old = s.list.findById(id);
+            size_t bytes = old ? recordUsage(*old).total() : 0;
+            if (!s.list.removeById(id)) return false;
+            adjustResident(s, -(long long)bytes);
+            return true;
+        });
+    }
+
+    bool updatePatient(const Patient& p) {
+        static LatencyHistogram& hist = opStats("patients.updatePatient");
+        ScopedTimer timer(hist);
+        PatientShard* sh = shardFor(p.id, false);
+        return sh && withShardIfMayContain(*sh, p.id, [&](PatientShard& s) {
+            const Patient* old = s.list.findById(p.id);
+            size_t bytes = old ? recordUsage(*old).total() : 0;
+            if (!s.list.updatePatient(p)) return false;
+            adjustResident(s, (long long)recordUsage(p).total() - (long long)bytes);
+            return true;
+        });
+    }
+
+    // Touches only the shard whose range covers id, and not even that one
+    // when the shard's id filter rules the id out; an evicted shard is read
+    // back from its file. No pointer into a shard is handed out, since the
+    // shard may be evicted as soon as its lock is released.
+    bool contains(int id) {
+        static LatencyHistogram& hist = opStats("patients.findById");
+        ScopedTimer timer(hist);
+        PatientShard* sh = shardFor(id, false);
+        return sh && withShardIfMayContain(*sh, id, [&](PatientShard& s) { return s.list.findById(id) != nullptr; });
+    }
+
+    // Thread-safe lookup that copies the record.
+    bool getById(int id, Patient& out) {
+        static LatencyHistogram& hist = opStats("patients.findById");
+        ScopedTimer timer(hist);
+        PatientShard* sh = shardFor(id, false);
+        return sh && withShardIfMayContain(*sh, id, [&](PatientShard& s) { return s.list.getById(id, out); });
+    }
+
+    int size() {
+        vector<PatientShard*> v = allShards();
+        vector<int> counts(v.size(), 0);
+        parallelFor((int)v.size(), [&](int i) {
+            lock_guard<mutex> lk(v[i]->loadMtx);
+            loadLocked(*v[i], false);
+            counts[i] = v[i]->list.size();
+        });
+        int n = 0;
+        for (int c : counts) n += c;
+        return n;
+    }
+
+    // O(number of shards); each shard's part is an O(1) copy-on-write
+    // snapshot, taken while the shard is loaded, so later evictions do not
+    // affect it.
+    PatientSnapshot snapshot() {
+        static LatencyHistogram& hist = opStats("patients.snapshot");
+        ScopedTimer timer(hist);
+        vector<PatientShard*> v = allShards();
+        vector<PatientSnapshot> parts(v.size());
+        parallelFor((int)v.size(), [&](int i) {
+            lock_guard<mutex> lk(v[i]->loadMtx);
+            loadLocked(*v[i], false);
+            parts[i] = v[i]->list.snapshot();
+        });
+        PatientSnapshot snap;
+        for (const auto& part : parts) snap.append(part);
+        return snap;
+    }
+
+    // Memory budget for resident shards in bytes (0 = no limit). Lowering
+    // it evicts right away as far as clean shards allow.
+    size_t memoryBudget() const { return budgetBytes; }
+    void setMemoryBudget(size_t bytes) {
+        budgetBytes = bytes;
+        makeRoom(nullptr);
+    }
+
+    // Exact accounting of every resident shard, by structure.
+    MemoryUsage memoryUsage() {
+        MemoryUsage u;
+        for (PatientShard* sh : allShards()) {
+            lock_guard<mutex> lk(sh->loadMtx);
+            if (!sh->loaded) continue;
+            recount(*sh);
+            u += sh->list.memoryUsage();
+        }
+        return u;
+    }
+
+    void printMemory(ostream& out) {
+        MemoryUsage u = memoryUsage();
+        auto mb = [](size_t b) { return b / (1024.0 * 1024.0); };
+        ios::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+        out << fixed << setprecision(2);
+        out << "Patient store memory (" << loadedShardCount() << " of " << shardCount() << " shards resident)\n";
+        out << "  Records : " << setw(10) << mb(u.records) << " MB\n";
+        out << "  Strings : " << setw(10) << mb(u.strings) << " MB\n";
+        out << "  Nodes   : " << setw(10) << mb(u.nodes) << " MB\n";
+        out << "  Index   : " << setw(10) << mb(u.index) << " MB\n";
+        out << "  Total   : " << setw(10) << mb(u.total()) << " MB\n";
+        out << "  Budget  : ";
+        if (budgetBytes == 0) out << "unlimited\n";
+        else out << setw(10) << mb(budgetBytes) << " MB\n";
+        out << "  Shard loads " << shardLoads.load() << ", evictions " << evictions.load() << '\n';
+        out.flags(flags);
+        out.precision(precision);
+    }
+    unsigned long long shardLoadCount() const { return shardLoads.load(); }
+    unsigned long long evictionCount() const { return evictions.load(); }
+
+    vector<Patient> toVector() { return snapshot().toVector(); }
+
+    void displayAll() {
+        PatientSnapshot snap = snapshot();
+        if (snap.empty()) {
+            cout << "No patient records.\n";
+            return;
+        }
+        cout << left << setw(6) << "ID" << setw(20) << "Name" << setw(6) << "Age"
+            << setw(8) << "Gender" << setw(15) << "Ailment" << setw(9) << "Priority"
+            << setw(15) << "Doctor" << setw(12) << "Phone" << '\n';
+        cout << string(95, '-') << '\n';
+        snap.forEach([](const Patient& p) {
+            cout << setw(6) << p.id << setw(20) << p.name << setw(6) << p.age
+                << setw(8) << p.gender << setw(15) << p.ailment << setw(9) << p.priority
+                << setw(15) << p.assignedDoctor << setw(12) << p.phone << '\n';
+        });
+    }
+
+    // Writes changed shards in parallel, then the manifest. Cold shards are
+    // left untouched on disk.
+    bool saveToFile() {
+        static LatencyHistogram& hist = opStats("patients.saveToFile");
+        ScopedTimer timer(hist);
+        vector<PatientShard*> v = allShards();
+        atomic<bool> ok(true);
+        parallelFor((int)v.size(), [&](int i) {
+            PatientShard& sh = *v[i];
+            lock_guard<mutex> lk(sh.loadMtx);
+            if (!sh.loaded) return;
+            if (sh.damaged) {
+                ok = false;
+                return;
+            }
+            PatientSnapshot snap = sh.list.snapshot();
+            bool packed = fileFormat == StorageFormat::Packed;
+            if (snap.version() == sh.savedVersion && sh.packedOnDisk == packed) return;
+            // a crash between the two writes must not leave the old filter
+            // next to the new shard; a missing filter only costs a load
+            std::remove(sh.bloomFile().c_str());
+            if (snap.saveToFile(sh.file, fileFormat) && sh.list.idFilter().saveToFile(sh.bloomFile())) {
+                sh.savedVersion = snap.version();
+                sh.packedOnDisk = packed;
+                recount(sh);
+            }
+            else ok = false;
+        });
+        bool manifestOk = saveManifest();
+        makeRoom(nullptr);                       // saved shards may now be dropped
+        return manifestOk && ok;
+    }
+
+    // Reads the manifest and registers every shard as cold. Without a
+    // manifest, falls back to a monolithic patients.txt and splits it.
+    bool loadFromFile(const string& legacyFile = "patients.txt") {
+        static LatencyHistogram& hist = opStats("patients.loadFromFile");
+        ScopedTimer timer(hist);
+        ifstream fin(manifestFile);
+        if (!fin.is_open()) {
+            PatientBackend legacy;
+            if (!legacy.loadFromFile(legacyFile)) return false;
+            clear();
+            vector<char> added;
+            insertBatch(legacy.snapshot().toVector(), added);
+            return true;
+        }
+        clear();
+        lock_guard<mutex> lk(mtx);
+        string line;
+        while (getline(fin, line)) {
+            vector<string> parts;
+            string cur;
+            for (size_t i = 0; i <= line.size(); ++i) {
+                if (i == line.size() || line[i] == '|') {
+                    parts.push_back(cur);
+                    cur.clear();
+                }
+                else cur.push_back(line[i]);
+            }
+            if (parts.size() < 3) continue;
+            try {
+                int lo = stoi(parts[0]);
+                int hi = stoi(parts[1]);
+                shards[lo] = make_unique<PatientShard>(lo, hi, parts[2]);
+            }
+            catch (...) {
+                continue;
+            }
+        }
+        fin.close();
+        // Filters are small; read them all now so cold lookups can use them.
+        vector<PatientShard*> v;
+        for (const auto& kv : shards) v.push_back(kv.second.get());
+        parallelFor((int)v.size(), [&](int i) {
+            v[i]->hasColdFilter = v[i]->coldFilter.loadFromFile(v[i]->bloomFile());
+        });
+        fileFormat = !v.empty() && isPackedFile(v.front()->file) ? StorageFormat::Packed : StorageFormat::Text;
+        return true;
+    }
+
+    void clear() {
+        lock_guard<mutex> lk(mtx);
+        shards.clear();
+        residentBytes = 0;
+    }
+
+    // Replaces the whole store with records ordered by id and unique, as
+    // produced by next(Patient&) until it returns false. Linear time.
+    template <typename Source>
+    void bulkLoadSorted(Source next) {
+        clear();
+        vector<Patient> batch;
+        PatientShard* cur = nullptr;
+        auto fill = [&]() {
+            lock_guard<mutex> lk(cur->loadMtx);
+            cur->list.bulkLoadUnique(batch);
+            recount(*cur);
+        };
+        Patient p;
+        while (next(p)) {
+            PatientShard* sh = shardFor(p.id, true);
+            if (sh != cur) {
+                if (cur) fill();
+                batch.clear();
+                cur = sh;
+            }
+            batch.push_back(p);
+        }
+        if (cur) fill();
+    }
+};
+
+// ---------------------------- QuickSort & Binary Search -------------------
+// QuickSort by patient id
+int partition(vector<Patient>& arr, int low, int high) {
+    int pivot = arr[high].id;
+    int i = low - 1;
+    for (int j = low; j <= high - 1; ++j) {
+        if (arr[j].id <= pivot) {
+            ++i;
+            swap(arr[i], arr[j]);
+        }
+    }
+    swap(arr[i + 1], arr[high]);
+    return (i + 1);
+}
+
+void quickSort(vector<Patient>& arr, int low, int high) {
+    if (low < high) {
+        int pi = partition(arr, low, high);
+        quickSort(arr, low, pi - 1);
+        quickSort(arr, pi + 1, high);
+    }
+}
+
+// Binary search on sorted vector by id
+int binarySearchById(const vector<Patient>& arr, int id) {
+    int l = 0, r = (int)arr.size() - 1;
+    while (l <= r) {
+        int m = l + (r - l) / 2;
+        if (arr[m].id == id) return m;
+        if (arr[m].id < id) l = m + 1;
+        else r = m - 1;
+    }
+    return -1;
+}
+
+// ---------------------------- Queue Time Series ---------------------------
+// Arrival / service history of a queue without keeping the events: each one
+// is folded into a one-minute bucket (ring of the last 2 hours) and a
+// one-hour bucket (ring of the last 2 days). A bucket holds counts, the
+// deepest queue seen and a small histogram of waits, so rolling throughput
+// and wait percentiles merge a few dozen buckets instead of rescanning.
+
+// Log-linear histogram of waits in ms: 8 sub-buckets per power of two
+// (~12% resolution) in 1.2 KB, so every time bucket can carry one.
+class WaitHistogram {
+private:
+    static const int SUB_BITS = 3;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = SUB + (42 - SUB_BITS) * SUB;     // up to 2^42 ms
+
+    uint32_t counts[BUCKETS];
+    unsigned long long total;
+    unsigned long long sumMs;
+    unsigned long long maxMs;
+
+    static int bucketOf(unsigned long long v) {
+        if (v < (unsigned long long)SUB) return (int)v;
+        int m = 0;
+        for (unsigned long long x = v; x >>= 1;) ++m;
+        int sub = (int)((v >> (m - SUB_BITS)) & (SUB - 1));
+        return min(BUCKETS - 1, SUB + (m - SUB_BITS) * SUB + sub);
+    }
+    static unsigned long long bucketHigh(int idx) {
+        if (idx < SUB) return (unsigned long long)idx;
+        int m = (idx - SUB) / SUB + SUB_BITS;
+        int sub = (idx - SUB) % SUB;
+        unsigned long long width = 1ULL << (m - SUB_BITS);
+        return ((unsigned long long)(SUB + sub) << (m - SUB_BITS)) + width - 1;
+    }
+public:
+    WaitHistogram() { clear(); }
+    void clear() {
+        memset(counts, 0, sizeof(counts));
+        total = sumMs = maxMs = 0;
+    }
+    void record(unsigned long long ms) {
+        ++counts[bucketOf(ms)];
+        ++total;
+        sumMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+    void merge(const WaitHistogram& o) {
+        for (int i = 0; i < BUCKETS; ++i) counts[i] += o.counts[i];
+        total += o.total;
+        sumMs += o.sumMs;
+        maxMs = std::max(maxMs, o.maxMs);
+    }
+    unsigned long long count() const { return total; }
+    unsigned long long max() const { return maxMs; }
+    double mean() const { return total ? (double)sumMs / total : 0.0; }
+    // nearest rank, q in [0, 1]
+    unsigned long long percentile(double q) const {
+        if (total == 0) return 0;
+        unsigned long long rank = std::max(1ULL, (unsigned long long)ceil(q * (double)total));
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return min(bucketHigh(i), maxMs);
+        }
+        return maxMs;
+    }
+};
+
+// Aggregate over a span of time (one bucket or a merged window).
+struct QueueWindow {
+    long long fromMs = 0;           // start of the oldest bucket included
+    long long spanMs = 0;           // time covered, up to "now" for a rolling window
+    unsigned long long arrivals = 0;
+    unsigned long long served = 0;
+    int peakDepth = 0;
+    WaitHistogram waits;            // time from arrival to service
+
+    double perHour(unsigned long long n) const { return spanMs > 0 ? n * 3600000.0 / spanMs : 0.0; }
+};
+
+class QueueTimeSeries {
+public:
+    static constexpr long long MINUTE_MS = 60000;
+    static constexpr long long HOUR_MS = 3600000;
+private:
+    struct Bucket {
+        long long epoch = -1;       // bucket number since time 0 (-1 = unused)
+        QueueWindow agg;
+    };
+    vector<Bucket> minutes;
+    vector<Bucket> hours;
+    mutable mutex mtx;
+
+    static QueueWindow* slot(vector<Bucket>& ring, long long widthMs, long long atMs) {
+        long long epoch = atMs / widthMs;
+        Bucket& b = ring[(size_t)(epoch % (long long)ring.size())];
+        if (b.epoch != epoch) {
+            if (b.epoch > epoch) return nullptr;    // older than the history kept
+            b.epoch = epoch;
+            b.agg.arrivals = b.agg.served = 0;
+            b.agg.peakDepth = 0;
+            b.agg.waits.clear();
+        }
+        return &b.agg;
+    }
+    const vector<Bucket>& ringFor(long long widthMs) const { return widthMs == MINUTE_MS ? minutes : hours; }
+public:
+    QueueTimeSeries(int minuteBuckets = 120, int hourBuckets = 48)
+        : minutes(max(1, minuteBuckets)), hours(max(1, hourBuckets)) {}
+
+    // depth = queue length after the arrival
+    void arrival(long long atMs, int depth) {
+        if (atMs < 0) return;
+        lock_guard<mutex> lk(mtx);
+        for (QueueWindow* w : { slot(minutes, MINUTE_MS, atMs), slot(hours, HOUR_MS, atMs) }) {
+            if (!w) continue;
+            ++w->arrivals;
+            w->peakDepth = max(w->peakDepth, depth);
+        }
+    }
+
+    void served(long long atMs, long long waitMs) {
+        if (atMs < 0) return;
+        lock_guard<mutex> lk(mtx);
+        for (QueueWindow* w : { slot(minutes, MINUTE_MS, atMs), slot(hours, HOUR_MS, atMs) }) {
+            if (!w) continue;
+            ++w->served;
+            w->waits.record((unsigned long long)max(0LL, waitMs));
+        }
+    }
+
+    // Rolling window of spanMs ending at nowMs: minute buckets while they
+    // reach back far enough, hour buckets (whole hours) beyond that.
+    QueueWindow window(long long nowMs, long long spanMs) const {
+        long long width = spanMs <= MINUTE_MS * (long long)minutes.size() ? MINUTE_MS : HOUR_MS;
+        const vector<Bucket>& ring = ringFor(width);
+        long long last = nowMs / width;
+        long long n = min((long long)ring.size(), max(1LL, (spanMs + width - 1) / width));
+        QueueWindow out;
+        out.fromMs = (last - n + 1) * width;
+        out.spanMs = max(1LL, nowMs - out.fromMs);
+        lock_guard<mutex> lk(mtx);
+        for (const auto& b : ring) {
+            if (b.epoch <= last - n || b.epoch > last) continue;
+            out.arrivals += b.agg.arrivals;
+            out.served += b.agg.served;
+            out.peakDepth = max(out.peakDepth, b.agg.peakDepth);
+            out.waits.merge(b.agg.waits);
+        }
+        return out;
+    }
+
+    // The count most recent buckets of widthMs (MINUTE_MS or HOUR_MS), oldest
+    // first; empty periods are included.
+    vector<QueueWindow> buckets(long long nowMs, long long widthMs, int count) const {
+        const vector<Bucket>& ring = ringFor(widthMs);
+        long long last = nowMs / widthMs;
+        long long n = min((long long)ring.size(), (long long)max(1, count));
+        vector<QueueWindow> out((size_t)n);
+        lock_guard<mutex> lk(mtx);
+        for (long long i = 0; i < n; ++i) {
+            long long epoch = last - n + 1 + i;
+            out[i].fromMs = epoch * widthMs;
+            out[i].spanMs = widthMs;
+            if (epoch < 0) continue;
+            const Bucket& b = ring[(size_t)(epoch % (long long)ring.size())];
+            if (b.epoch == epoch) {
+                out[i] = b.agg;
+                out[i].fromMs = epoch * widthMs;
+                out[i].spanMs = widthMs;
+            }
+        }
+        return out;
+    }
+};
+
+// ---------------------------- Appointment Management ---------------------
+struct Appointment {
+    int patientId;
+    string timeSlot;
+    string notes;
+    long long arrival; // ms timestamp when queued (0 = not yet queued)
+
+    Appointment() : patientId(0), timeSlot(""), notes(""), arrival(0) {}
+    Appointment(int pid, const string& ts, const string& n, long long at = 0)
+        : patientId(pid), timeSlot(ts), notes(n), arrival(at) {}
+
+    string serialize() const {
+        // pid|timeslot|notes|arrival
+        ostringstream oss;
+        oss << patientId << '|' << timeSlot << '|' << notes << '|' << arrival;
+        return oss.str();
+    }
+
+    static bool deserialize(const string& line, Appointment& a) {
+        if (line.empty()) return false;
+        size_t first = line.find('|');
+        size_t second = first == string::npos ? string::npos : line.find('|', first + 1);
+        if (second == string::npos) return false;
+        try {
+            a.patientId = stoi(line.substr(0, first));
+            a.timeSlot = line.substr(first + 1, second - first - 1);
+            splitNotesArrival(line.substr(second + 1), a.notes, a.arrival);
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+};
+
+class AppointmentManager {
+private:
+    queue<Appointment> routineQueue;
+    QueueTimeSeries series;
+public:
+    AppointmentManager() {}
+
+    void scheduleRoutine(const Appointment& a) {
+        static LatencyHistogram& hist = opStats("appointments.scheduleRoutine");
+        ScopedTimer timer(hist);
+        Appointment stamped = a;
+        if (stamped.arrival == 0) stamped.arrival = nowMillis();
+        routineQueue.push(stamped);
+        series.arrival(stamped.arrival, (int)routineQueue.size());
+    }
+    bool hasRoutine() const { return !routineQueue.empty(); }
+    int size() const { return (int)routineQueue.size(); }
+    // nowMs = 0 means the wall clock; the simulator passes its virtual time.
+    Appointment popNextRoutine(long long nowMs = 0) {
+        static LatencyHistogram& hist = opStats("appointments.popNextRoutine");
+        ScopedTimer timer(hist);
+        if (routineQueue.empty()) return Appointment();
+        Appointment a = routineQueue.front();
+        routineQueue.pop();
+        if (nowMs == 0) nowMs = nowMillis();
+        series.served(nowMs, nowMs - a.arrival);
+        return a;
+    }
+    // Arrivals and waits since start-up (loaded appointments are not arrivals).
+    const QueueTimeSeries& history() const { return series; }
+    // persistence
+    bool saveToFile(const string& filename = "appointments.txt") const {
+        static LatencyHistogram& hist = opStats("appointments.saveToFile");
+        ScopedTimer timer(hist);
+        ofstream fout(filename);
+        if (!fout.is_open()) return false;
+        queue<Appointment> copy = routineQueue;
+        while (!copy.empty()) {
+            fout << copy.front().serialize() << '\n';
+            copy.pop();
+        }
+        fout.close();
+        return true;
+    }
+    bool loadFromFile(const string& filename = "appointments.txt") {
+        static LatencyHistogram& hist = opStats("appointments.loadFromFile");
+        ScopedTimer timer(hist);
+        ifstream fin(filename);
+        if (!fin.is_open()) return false;
+        // clear existing
+        routineQueue = queue<Appointment>();
+        long long now = nowMillis();
+        string line;
+        while (getline(fin, line)) {
+            Appointment a;
+            if (!Appointment::deserialize(line, a)) continue;
+            if (a.arrival == 0) a.arrival = now;
+            routineQueue.push(a);
+        }
+        fin.close();
+        return true;
+    }
+};
+
+// ---------------------------- Emergency Management -----------------------
+struct EmergencyItem {
+    int patientId;
+    int priority; // higher = more urgent
+    string notes;
+    long long arrival; // ms timestamp when queued (0 = not yet queued)
+    EmergencyItem() : patientId(0), priority(0), notes(""), arrival(0) {}
+    EmergencyItem(int pid, int pr, const string& n, long long at = 0) : patientId(pid), priority(pr), notes(n), arrival(at) {}
+    string serialize() const {
+        ostringstream oss;
+        oss << patientId << '|' << priority << '|' << notes << '|' << arrival;
+        return oss.str();
+    }
+    static bool deserialize(const string& line, EmergencyItem& e) {
+        if (line.empty()) return false;
+        size_t first = line.find('|');
+        size_t second = first == string::npos ? string::npos : line.find('|', first + 1);
+        if (second == string::npos) return false;
+        try {
+            e.patientId = stoi(line.substr(0, first));
+            e.priority = stoi(line.substr(first + 1, second - first - 1));
+            splitNotesArrival(line.substr(second + 1), e.notes, e.arrival);
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+};
+
+// Packed emergencies: patient ids, priorities and arrival times as zigzag
+// deltas; notes dictionary-encoded (free text, but mostly repeated).
+struct EmergencyCodec {
+    typedef EmergencyItem Record;
+    static const char kind = 'E';
+    static void encode(const vector<EmergencyItem>& v, ByteWriter& w) {
+        long long prev = 0;
+        for (const auto& e : v) {
+            w.putSigned(e.patientId - prev);
+            prev = e.patientId;
+        }
+        for (const auto& e : v) w.putSigned(e.priority);
+        prev = 0;
+        for (const auto& e : v) {
+            w.putSigned(e.arrival - prev);
+            prev = e.arrival;
+        }
+        DictColumn notes;
+        for (const auto& e : v) notes.add(e.notes);
+        notes.writeTo(w);
+    }
+    static bool decode(ByteReader& r, vector<EmergencyItem>& v) {
+        long long prev = 0;
+        for (auto& e : v) {
+            prev += r.getSigned();
+            e.patientId = (int)prev;
+        }
+        for (auto& e : v) e.priority = (int)r.getSigned();
+        prev = 0;
+        for (auto& e : v) {
+            prev += r.getSigned();
+            e.arrival = prev;
+        }
+        if (!DictColumn::read(r, v.size(), [&](size_t i, const string& s) { v[i].notes = s; })) return false;
+        return r.good() && r.atEnd();
+    }
+};
+
+// comparator for priority queue (max-heap)
+// With aging, a waiting item gains agingPerMinute priority per minute. All
+// items age at the same rate, so ordering by priority - aging * arrival is
+// the same at every instant and the heap never needs re-sorting. Equal keys
+// are served first come, first served.
+struct EmergencyCompare {
+    double agingPerMinute;
+    explicit EmergencyCompare(double aging = 0.0) : agingPerMinute(aging) {}
+    double key(const EmergencyItem& e) const { return e.priority - agingPerMinute * (e.arrival / 60000.0); }
+    bool operator()(const EmergencyItem& a, const EmergencyItem& b) const {
+        double ka = key(a), kb = key(b);
+        if (ka != kb) return ka < kb; // top = highest priority
+        return a.arrival > b.arrival;
+    }
+};
+
+class EmergencyManager {
+private:
+    priority_queue<EmergencyItem, vector<EmergencyItem>, EmergencyCompare> emergencyQueue;
+    double agingPerMinute;
+    StorageFormat fileFormat;
+    AilmentTrends* trends = nullptr;
+    ShardedPatientStore* patients = nullptr;    // ailment lookup for trends
+    QueueTimeSeries series;
+    string damagedFile;         // packed file loaded with bad blocks; never overwritten
+public:
+    EmergencyManager() : agingPerMinute(0.0), fileFormat(StorageFormat::Text) {}
+
+    // Set when the last load found damaged blocks: the queue holds what
+    // the good blocks contained and saving over that file is refused.
+    bool damaged() const { return !damagedFile.empty(); }
+    const string& damagedPath() const { return damagedFile; }
+
+    // New emergencies feed the trend sketches with their patient's ailment.
+    void attachTrends(AilmentTrends* t, ShardedPatientStore* store) {
+        trends = t;
+        patients = store;
+    }
+
+    // Format used by saveToFile(); loadFromFile() reads either and adopts it.
+    StorageFormat format() const { return fileFormat; }
+    void setFormat(StorageFormat f) { fileFormat = f; }
+
+    void scheduleEmergency(const EmergencyItem& e) {
+        static LatencyHistogram& hist = opStats("emergencies.scheduleEmergency");
+        ScopedTimer timer(hist);
+        EmergencyItem stamped = e;
+        if (stamped.arrival == 0) stamped.arrival = nowMillis();
+        emergencyQueue.push(stamped);
+        series.arrival(stamped.arrival, (int)emergencyQueue.size());
+        Patient p;
+        if (trends && patients && patients->getById(e.patientId, p))
+            trends->record(TrendSource::Emergencies, p.ailment, stamped.arrival);
+    }
+
+    bool hasEmergency() const { return !emergencyQueue.empty(); }
+    int size() const { return (int)emergencyQueue.size(); }
+    // nowMs = 0 means the wall clock; the simulator passes its virtual time.
+    EmergencyItem popNextEmergency(long long nowMs = 0) {
+        static LatencyHistogram& hist = opStats("emergencies.popNextEmergency");
+        ScopedTimer timer(hist);
+        if (emergencyQueue.empty()) return EmergencyItem();
+        EmergencyItem e = takeNext();
+        markServed(e, nowMs);
+        return e;
+    }
+
+    // For callers that may put the item back: takeNext() removes the top
+    // item without counting it as served; follow with markServed() or
+    // requeue() (which is not a new arrival).
+    EmergencyItem takeNext() {
+        EmergencyItem e = emergencyQueue.top();
+        emergencyQueue.pop();
+        return e;
+    }
+    void markServed(const EmergencyItem& e, long long nowMs = 0) {
+        if (nowMs == 0) nowMs = nowMillis();
+        series.served(nowMs, nowMs - e.arrival);
+    }
+    void requeue(const EmergencyItem& e) { emergencyQueue.push(e); }
+
+    // Arrivals and waits since start-up (loaded items are not arrivals).
+    const QueueTimeSeries& history() const { return series; }
+
+    // Priority points gained per minute of waiting (0 = strict priority).
+    double aging() const { return agingPerMinute; }
+    void setAging(double perMinute) {
+        agingPerMinute = max(0.0, perMinute);
+        vector<EmergencyItem> items;
+        while (!emergencyQueue.empty()) {
+            items.push_back(emergencyQueue.top());
+            emergencyQueue.pop();
+        }
+        emergencyQueue = priority_queue<EmergencyItem, vector<EmergencyItem>, EmergencyCompare>(
+            EmergencyCompare(agingPerMinute), std::move(items));
+    }
+
+    // linear search for patientId in emergency queue (inefficient but requested)
+    bool linearSearchPatient(int pid) const {
+        // priority_queue doesn't allow iteration; copy it
+        auto copy = emergencyQueue;
+        while (!copy.empty()) {
+            if (copy.top().patientId == pid) return true;
+            copy.pop();
+        }
+        return false;
+    }
+
+    bool saveToFile(const string& filename = "emergencies.txt") const { return saveToFile(filename, fileFormat); }
+    bool saveToFile(const string& filename, StorageFormat fmt) const {
+        static LatencyHistogram& hist = opStats("emergencies.saveToFile");
+        ScopedTimer timer(hist);
+        if (filename == damagedFile) return false;
+        if (fmt == StorageFormat::Packed) {
+            PackedWriter<EmergencyCodec> w(filename);
+            if (!w.isOpen()) return false;
+            auto copy = emergencyQueue;
+            while (!copy.empty()) {
+                w.add(copy.top());
+                copy.pop();
+            }
+            return w.finish();
+        }
+        ofstream fout(filename);
+        if (!fout.is_open()) return false;
+        auto copy = emergencyQueue;
+        while (!copy.empty()) {
+            fout << copy.top().serialize() << '\n';
+            copy.pop();
+        }
+        fout.close();
+        return true;
+    }
+
+    bool loadFromFile(const string& filename = "emergencies.txt") {
+        static LatencyHistogram& hist = opStats("emergencies.loadFromFile");
+        ScopedTimer timer(hist);
+        long long now = nowMillis();
+        if (isPackedFile(filename)) {
+            PackedReader<EmergencyCodec> r(filename);
+            vector<EmergencyItem> items, block;
+            while (r.nextBlock(block)) items.insert(items.end(), block.begin(), block.end());
+            for (auto& e : items) if (e.arrival == 0) e.arrival = now;
+            emergencyQueue = priority_queue<EmergencyItem, vector<EmergencyItem>, EmergencyCompare>(
+                EmergencyCompare(agingPerMinute), std::move(items));
+            fileFormat = StorageFormat::Packed;
+            damagedFile = r.ok() ? "" : filename;
+            return r.ok();
+        }
+        ifstream fin(filename);
+        if (!fin.is_open()) return false;
+        fileFormat = StorageFormat::Text;
+        damagedFile.clear();
+        emergencyQueue = priority_queue<EmergencyItem, vector<EmergencyItem>, EmergencyCompare>(EmergencyCompare(agingPerMinute));
+        string line;
+        while (getline(fin, line)) {
+            EmergencyItem e;
+            if (!EmergencyItem::deserialize(line, e)) continue;
+            if (e.arrival == 0) e.arrival = now;
+            emergencyQueue.push(e);
+        }
+        fin.close();
+        return true;
+    }
+};
+
+// ---------------------------- Doctor / Staff DB (Hash Table) -------------
+class DoctorDB {
+private:
+    // doctorName -> vector of available time slots
+    unordered_map<string, vector<string>> doctors;
+    // staffName -> role
+    unordered_map<string, string> staff; // e.g., "Nurse A" -> "nurse"
+    // doctorName -> specialty (absent = general practice)
+    unordered_map<string, string> specialties;
+    // bumped whenever the doctor roster or a specialty changes
+    unsigned long long rosterVersion = 0;
+
+public:
+    DoctorDB() {}
+
+    void addDoctor(const string& name) {
+        if (doctors.find(name) == doctors.end()) {
+            doctors[name] = vector<string>();
+            ++rosterVersion;
+        }
+    }
+
+    bool removeDoctor(const string& name) {
+        auto it = doctors.find(name);
+        if (it == doctors.end()) return false;
+        doctors.erase(it);
+        specialties.erase(name);
+        ++rosterVersion;
+        return true;
+    }
+
+    bool hasDoctor(const string& name) const { return doctors.find(name) != doctors.end(); }
+    int doctorCount() const { return (int)doctors.size(); }
+    unsigned long long version() const { return rosterVersion; }
+
+    // Empty specialty = general practice.
+    bool setSpecialty(const string& name, const string& specialty) {
+        if (doctors.find(name) == doctors.end()) return false;
+        if (specialty.empty()) specialties.erase(name);
+        else specialties[name] = specialty;
+        ++rosterVersion;
+        return true;
+    }
+    string specialtyOf(const string& name) const {
+        auto it = specialties.find(name);
+        return it == specialties.end() ? "" : it->second;
+    }
+
+    bool addAvailability(const string& name, const string& timeslot) {
+        auto it = doctors.find(name);
+        if (it == doctors.end()) return false;
+        it->second.push_back(timeslot);
+        return true;
+    }
+
+    bool removeAvailability(const string& name, const string& timeslot) {
+        auto it = doctors.find(name);
+        if (it == doctors.end()) return false;
+        auto& vec = it->second;
+        auto f = find(vec.begin(), vec.end(), timeslot);
+        if (f == vec.end()) return false;
+        vec.erase(f);
+        return true;
+    }
+
+    vector<pair<string, vector<string>>> listAllDoctors() const {
+        vector<pair<string, vector<string>>> out;
+        for (const auto& kv : doctors) out.push_back(kv);
+        return out;
+    }
+
+    // Staff functions
+    void addStaff(const string& name, const string& role) { staff[name] = role; }
+    bool removeStaff(const string& name) {
+        auto it = staff.find(name);
+        if (it == staff.end()) return false;
+        staff.erase(it);
+        return true;
+    }
+    vector<pair<string, string>> listAllStaff() const {
+        vector<pair<string, string>> out;
+        for (const auto& kv : staff) out.push_back(kv);
+        return out;
+    }
+
+    // persistence: doctors and staff in separate files
+    bool saveDoctors(const string& filename = "doctors.txt") const {
+        static LatencyHistogram& hist = opStats("doctors.saveDoctors");
+        ScopedTimer timer(hist);
+        ofstream fout(filename);
+        if (!fout.is_open()) return false;
+        // Format: doctor|slot1;slot2;slot3[|specialty]
+        for (const auto& kv : doctors) {
+            fout << kv.first << '|';
+            for (size_t i = 0; i < kv.second.size(); ++i) {
+                fout << kv.second[i];
+                if (i + 1 < kv.second.size()) fout << ';';
+            }
+            string spec = specialtyOf(kv.first);
+            if (!spec.empty()) fout << '|' << spec;
+            fout << '\n';
+        }
+        fout.close();
+        return true;
+    }
+
+    bool loadDoctors(const string& filename = "doctors.txt") {
+        static LatencyHistogram& hist = opStats("doctors.loadDoctors");
+        ScopedTimer timer(hist);
+        ifstream fin(filename);
+        if (!fin.is_open()) return false;
+        doctors.clear();
+        specialties.clear();
+        ++rosterVersion;
+        string line;
+        while (getline(fin, line)) {
+            if (line.empty()) continue;
+            size_t pos = line.find('|');
+            if (pos == string::npos) continue;
+            string name = line.substr(0, pos);
+            string slots = line.substr(pos + 1);
+            size_t specPos = slots.find('|');
+            if (specPos != string::npos) {
+                if (specPos + 1 < slots.size()) specialties[name] = slots.substr(specPos + 1);
+                slots.erase(specPos);
+            }
+            vector<string> v;
+            string cur;
+            for (size_t i = 0; i <= slots.size(); ++i) {
+                if (i == slots.size() || slots[i] == ';') {
+                    if (!cur.empty()) v.push_back(cur);
+                    cur.clear();
+                }
+                else cur.push_back(slots[i]);
+            }
+            doctors[name] = v;
+        }
+        fin.close();
+        return true;
+    }
+
+    bool saveStaff(const string& filename = "staff.txt") const {
+        ofstream fout(filename);
+        if (!fout.is_open()) return false;
+        // Format: staffName|role
+        for (const auto& kv : staff) fout << kv.first << '|' << kv.second << '\n';
+        fout.close();
+        return true;
+    }
+
+    bool loadStaff(const string& filename = "staff.txt") {
+        ifstream fin(filename);
+        if (!fin.is_open()) return false;
+        staff.clear();
+        string line;
+        while (getline(fin, line)) {
+            if (line.empty()) continue;
+            size_t pos = line.find('|');
+            if (pos == string::npos) continue;
+            string name = line.substr(0, pos);
+            string role = line.substr(pos + 1);
+            staff[name] = role;
+        }
+        fin.close();
+        return true;
+    }
+};
+
+// ---------------------------- External Sort (bounded memory) -------------
+// Approximate heap footprint of one record, used to enforce memory caps.
+inline size_t patientBytes(const Patient& p) {
+    return sizeof(Patient) + p.name.capacity() + p.gender.capacity() + p.ailment.capacity()
+        + p.phone.capacity() + p.assignedDoctor.capacity();
+}
+
+// Sequential reader over a patient file in either format; skips malformed
+// text lines and damaged packed blocks. ok() turns false when the file could
+// not be opened or part of it could not be read.
+class PatientFileReader {
+private:
+    ifstream fin;
+    unique_ptr<PackedReader<PatientCodec>> packed;
+    vector<Patient> block;
+    size_t pos;
+    Patient cur;
+    bool has;
+public:
+    explicit PatientFileReader(const string& filename) : pos(0), has(false) {
+        if (isPackedFile(filename)) packed = make_unique<PackedReader<PatientCodec>>(filename);
+        else fin.open(filename);
+        advance();
+    }
+    bool valid() const { return has; }
+    bool ok() const { return packed ? packed->ok() : fin.is_open() && !fin.bad(); }
+    const Patient& current() const { return cur; }
+    void advance() {
+        has = false;
+        if (packed) {
+            while (pos == block.size()) {
+                pos = 0;
+                if (!packed->nextBlock(block)) {
+                    block.clear();
+                    return;
+                }
+            }
+            cur = std::move(block[pos++]);
+            has = true;
+            return;
+        }
+        string line;
+        while (getline(fin, line)) {
+            if (Patient::deserialize(line, cur)) {
+                has = true;
+                return;
+            }
+        }
+    }
+};
+
+// Most run files a merge keeps open at once; more runs are first merged in
+// passes (mergeRunsBounded).
+static const size_t MERGE_FAN_IN = 64;
+
+// k-way merge of files that are each sorted by id, using a min-heap of the
+// current head of every file. Equal ids come out in source order. Check ok()
+// after construction and at the end: a run that cannot be read must not
+// pass for a short one.
+class PatientMergeStream {
+private:
+    vector<unique_ptr<PatientFileReader>> readers;
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> heap; // (id, source)
+public:
+    explicit PatientMergeStream(const vector<string>& files) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            readers.push_back(make_unique<PatientFileReader>(files[i]));
+            if (readers.back()->valid()) heap.push({ readers.back()->current().id, (int)i });
+        }
+    }
+
+    bool ok() const {
+        for (const auto& r : readers)
+            if (!r->ok()) return false;
+        return true;
+    }
+
+    bool next(Patient& out, int& source) {
+        if (heap.empty()) return false;
+        source = heap.top().second;
+        heap.pop();
+        PatientFileReader& r = *readers[source];
+        out = r.current();
+        r.advance();
+        if (r.valid()) heap.push({ r.current().id, source });
+        return true;
+    }
+};
+
+// Removes its files when it goes out of scope.
+struct TempFileSet {
+    vector<string> files;
+    TempFileSet() {}
+    TempFileSet(const TempFileSet&) = delete;
+    TempFileSet& operator=(const TempFileSet&) = delete;
+    ~TempFileSet() {
+        for (const auto& f : files) std::remove(f.c_str());
+    }
+};
+
+// Reads the inputs in order, buffering at most memoryCap bytes of records.
+// Each full buffer is sorted by id and written as a run file; onRecord sees
+// every record once, so statistics can be gathered in the same pass.
+// Returns false if an input could not be read or a run file written.
+template <typename Fn>
+bool writeSortedRuns(const vector<string>& inputs, size_t memoryCap, const string& runPrefix,
+    TempFileSet& runs, Fn onRecord) {
+    vector<Patient> buf;
+    size_t used = 0;
+    bool written = true;
+    auto flush = [&]() {
+        if (buf.empty()) return;
+        stable_sort(buf.begin(), buf.end(), [](const Patient& a, const Patient& b) { return a.id < b.id; });
+        ostringstream name;
+        name << runPrefix << runs.files.size() << ".tmp";
+        runs.files.push_back(name.str());
+        ofstream fout(runs.files.back());
+        for (const auto& p : buf) fout << p.serialize() << '\n';
+        fout.close();
+        if (!fout) written = false;
+        buf.clear();
+        used = 0;
+    };
+    for (const auto& in : inputs) {
+        PatientFileReader r(in);
+        for (; r.valid(); r.advance()) {
+            const Patient& p = r.current();
+            onRecord(p);
+            size_t b = patientBytes(p);
+            if (!buf.empty() && used + b > memoryCap) flush();
+            buf.push_back(p);
+            used += b;
+        }
+        if (!r.ok()) written = false;
+    }
+    flush();
+    return written;
+}
+
+// Merges consecutive groups of up to MERGE_FAN_IN runs into intermediate
+// runs (registered in temps) until at most limit are left, so no merge holds
+// more files open than the fan-in. Groups keep their order, so equal ids
+// still come out of the final merge in the order of the original runs.
+// Returns false if a run could not be read or written.
+inline bool mergeRunsBounded(vector<string>& runs, size_t limit, const string& runPrefix, TempFileSet& temps) {
+    limit = max<size_t>(1, min(limit, MERGE_FAN_IN));
+    while (runs.size() > limit) {
+        vector<string> next;
+        size_t group = runs.size() <= MERGE_FAN_IN ? runs.size() : MERGE_FAN_IN;
+        for (size_t at = 0; at < runs.size(); at += group) {
+            vector<string> part(runs.begin() + at, runs.begin() + min(runs.size(), at + group));
+            if (part.size() == 1) {
+                next.push_back(part[0]);
+                continue;
+            }
+            ostringstream name;
+            name << runPrefix << temps.files.size() << ".tmp";
+            temps.files.push_back(name.str());
+            PatientMergeStream merged(part);
+            if (!merged.ok()) return false;
+            ofstream fout(temps.files.back());
+            Patient p;
+            int src;
+            while (merged.next(p, src)) fout << p.serialize() << '\n';
+            fout.close();
+            if (!fout || !merged.ok()) return false;
+            next.push_back(temps.files.back());
+        }
+        runs.swap(next);
+    }
+    return true;
+}
+
+// ---------------------------- Emergency Dispatch -------------------------
+// Pairs queued emergencies with free doctors. Each round walks the triage
+// heap from the top, so a higher-priority case is never passed over for a
+// doctor that could treat it. For each case, in order of preference:
+//   1. the patient's assignedDoctor, if free and suitable
+//   2. a free doctor with the specialty the ailment calls for
+//   3. a free general doctor (specialists are kept for cases needing them)
+//   4. any free doctor, when the case needs no particular specialty
+// Free doctors are indexed by specialty, so each match is O(log doctors).
+// Cases with no suitable free doctor go back to the queue, keeping their
+// arrival time; aging in EmergencyManager stops them starving.
+struct DispatchDecision {
+    int patientId;
+    string doctor;
+    int priority;
+    long long waitedMs;
+};
+
+class DispatchEngine {
+private:
+    EmergencyManager& em;
+    DoctorDB& db;
+    ShardedPatientStore& patients;
+    unordered_map<string, string> ailmentSpecialty;     // ailment -> specialty
+    unordered_map<string, int> busy;                    // doctor -> patient id
+    map<string, set<string>> freeBySpecialty;           // "" = general
+    int maxScan;                                        // cases examined per round
+    long long dispatched;
+    unsigned long long syncedVersion;                   // DoctorDB version indexed
+    bool synced;
+
+    // Rebuilds the free-doctor index only when the roster has changed;
+    // otherwise release() keeps it up to date.
+    void syncDoctors() {
+        if (synced && syncedVersion == db.version()) return;
+        freeBySpecialty.clear();
+        for (const auto& d : db.listAllDoctors()) {
+            if (busy.count(d.first)) continue;
+            freeBySpecialty[db.specialtyOf(d.first)].insert(d.first);
+        }
+        for (auto it = busy.begin(); it != busy.end();) {
+            if (db.hasDoctor(it->first)) ++it;
+            else it = busy.erase(it);           // doctor left the roster
+        }
+        syncedVersion = db.version();
+        synced = true;
+    }
+
+    bool takeFree(const string& doctor) {
+        auto it = freeBySpecialty.find(db.specialtyOf(doctor));
+        if (it == freeBySpecialty.end() || !it->second.erase(doctor)) return false;
+        return true;
+    }
+
+    bool takeAny(const string& specialty, string& doctor) {
+        auto it = freeBySpecialty.find(specialty);
+        if (it == freeBySpecialty.end() || it->second.empty()) return false;
+        doctor = *it->second.begin();
+        it->second.erase(it->second.begin());
+        return true;
+    }
+
+    int freeCount() const {
+        int n = 0;
+        for (const auto& kv : freeBySpecialty) n += (int)kv.second.size();
+        return n;
+    }
+
+    bool match(const EmergencyItem& e, string& doctor) {
+        Patient p;
+        bool known = patients.getById(e.patientId, p);
+        string need;
+        if (known) {
+            auto it = ailmentSpecialty.find(p.ailment);
+            if (it != ailmentSpecialty.end()) need = it->second;
+        }
+        if (known && !p.assignedDoctor.empty() && !busy.count(p.assignedDoctor) && db.hasDoctor(p.assignedDoctor)) {
+            string spec = db.specialtyOf(p.assignedDoctor);
+            if ((need.empty() || spec == need || spec.empty()) && takeFree(p.assignedDoctor)) {
+                doctor = p.assignedDoctor;
+                return true;
+            }
+        }
+        if (!need.empty() && takeAny(need, doctor)) return true;
+        if (takeAny("", doctor)) return true;
+        if (need.empty()) {
+            for (auto& kv : freeBySpecialty) {
+                if (kv.second.empty()) continue;
+                doctor = *kv.second.begin();
+                kv.second.erase(kv.second.begin());
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    DispatchEngine(EmergencyManager& e, DoctorDB& d, ShardedPatientStore& p, int scanLimit = 256)
+        : em(e), db(d), patients(p), maxScan(max(1, scanLimit)), dispatched(0), syncedVersion(0), synced(false) {}
+
+    void setAilmentSpecialty(const string& ailment, const string& specialty) {
+        if (specialty.empty()) ailmentSpecialty.erase(ailment);
+        else ailmentSpecialty[ailment] = specialty;
+    }
+
+    const unordered_map<string, string>& ailmentSpecialties() const { return ailmentSpecialty; }
+    long long totalDispatched() const { return dispatched; }
+    int busyCount() const { return (int)busy.size(); }
+    vector<pair<string, int>> busyDoctors() const { return vector<pair<string, int>>(busy.begin(), busy.end()); }
+
+    // The doctor has finished with their patient and can be dispatched again.
+    bool release(const string& doctor) {
+        if (!busy.erase(doctor)) return false;
+        if (synced && syncedVersion == db.version()) freeBySpecialty[db.specialtyOf(doctor)].insert(doctor);
+        return true;
+    }
+
+    int freeDoctors() {
+        syncDoctors();
+        return freeCount();
+    }
+
+    // Books any free doctor, general practice first, for non-emergency work
+    // (e.g. a routine visit). The doctor stays busy until release().
+    bool occupyAny(int patientId, string& doctor) {
+        syncDoctors();
+        if (!takeAny("", doctor)) {
+            auto it = find_if(freeBySpecialty.begin(), freeBySpecialty.end(),
+                [](const pair<const string, set<string>>& kv) { return !kv.second.empty(); });
+            if (it == freeBySpecialty.end()) return false;
+            doctor = *it->second.begin();
+            it->second.erase(it->second.begin());
+        }
+        busy[doctor] = patientId;
+        return true;
+    }
+
+    // One dispatch round at time nowMs: assigns as many queued emergencies as
+    // there are suitable free doctors, highest (aged) priority first.
+    vector<DispatchDecision> dispatch(long long nowMs) {
+        static LatencyHistogram& roundHist = opStats("dispatch.round");
+        static LatencyHistogram& waitHist = opStats("dispatch.waitTime");
+        ScopedTimer timer(roundHist);
+        vector<DispatchDecision> out;
+        syncDoctors();
+        vector<EmergencyItem> deferred;
+        int scanned = 0;
+        while (em.hasEmergency() && freeCount() > 0 && scanned < maxScan) {
+            EmergencyItem e = em.takeNext();
+            ++scanned;
+            string doctor;
+            if (!match(e, doctor)) {
+                deferred.push_back(e);
+                continue;
+            }
+            busy[doctor] = e.patientId;
+            em.markServed(e, nowMs);
+            long long waited = max(0LL, nowMs - e.arrival);
+            if (!StatsRegistry::paused()) waitHist.record((unsigned long long)waited * 1000000ULL);
+            out.push_back({ e.patientId, doctor, e.priority, waited });
+            ++dispatched;
+        }
+        for (const auto& e : deferred) em.requeue(e);
+        return out;
+    }
+};
+
+// ---------------------------- Hospital Simulation -------------------------
+// Discrete-event simulation of a hospital day on a virtual clock. Routine and
+// emergency patients arrive as Poisson processes and are queued, prioritised
+// and matched by the real AppointmentManager, EmergencyManager and
+// DispatchEngine, so a policy change (aging, specialties) can be replayed in
+// seconds without touching production data.
+struct SimConfig {
+    double hours = 24.0;
+    double routinePerHour = 40.0;
+    double emergencyPerHour = 8.0;
+    double routineServiceMin = 15.0;   // mean minutes per visit (exponential)
+    double emergencyServiceMin = 45.0;
+    int doctors = 10;                  // used only when the roster is empty
+    double agingPerMinute = 0.0;
+    int population = 5000;             // synthetic patients to draw from
+    unsigned long long seed = 42;
+};
+
+struct SimResult {
+    long long events = 0;
+    long long routineArrived = 0, emergencyArrived = 0;
+    long long routineServed = 0, emergencyServed = 0;
+    double avgRoutineQueue = 0, avgEmergencyQueue = 0;
+    int maxRoutineQueue = 0, maxEmergencyQueue = 0;
+    int doctors = 0;
+    double utilization = 0;            // busy doctor time / available doctor time
+    double wallSeconds = 0;
+    LatencyHistogram routineWait, emergencyWait, urgentWait;   // virtual ms; urgent = priority >= 8
+
+    void print(ostream& out, double hours) const {
+        ios::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+        out << "Simulated " << fixed << setprecision(1) << hours << "h with " << doctors << " doctors: "
+            << events << " events in " << setprecision(3) << wallSeconds << "s ("
+            << setprecision(0) << (wallSeconds > 0 ? events / wallSeconds : 0.0) << " events/sec)\n";
+        out << left << setw(12) << "Queue" << right << setw(10) << "Arrived" << setw(10) << "Served"
+            << setw(10) << "Per hour" << setw(10) << "Avg len" << setw(10) << "Max len"
+            << setw(10) << "p50(min)" << setw(10) << "p90(min)" << setw(10) << "p99(min)" << '\n';
+        out << string(92, '-') << '\n';
+        auto row = [&](const string& name, long long arrived, long long served, double avgLen, int maxLen,
+                       const LatencyHistogram& w) {
+            out << left << setw(12) << name << right << setw(10) << arrived << setw(10) << served
+                << fixed << setprecision(1) << setw(10) << (hours > 0 ? served / hours : 0.0)
+                << setw(10) << avgLen << setw(10) << maxLen
+                << setw(10) << w.percentile(0.50) / 60000.0 << setw(10) << w.percentile(0.90) / 60000.0
+                << setw(10) << w.percentile(0.99) / 60000.0 << '\n';
+        };
+        row("Routine", routineArrived, routineServed, avgRoutineQueue, maxRoutineQueue, routineWait);
+        row("Emergency", emergencyArrived, emergencyServed, avgEmergencyQueue, maxEmergencyQueue, emergencyWait);
+        out << left << setw(12) << "  urgent" << right << setw(50) << "" << fixed << setprecision(1)
+            << setw(10) << urgentWait.percentile(0.50) / 60000.0 << setw(10) << urgentWait.percentile(0.90) / 60000.0
+            << setw(10) << urgentWait.percentile(0.99) / 60000.0 << '\n';
+        out << "Doctor utilization: " << setprecision(1) << utilization * 100.0 << "%\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+};
+
+class HospitalSimulator {
+private:
+    enum EventKind { RoutineArrival, EmergencyArrival, ServiceDone };
+    struct SimEvent {
+        long long at;          // virtual ms
+        long long seq;         // FIFO among simultaneous events
+        EventKind kind;
+        int doctor;            // index into doctorNames for ServiceDone
+        bool operator>(const SimEvent& o) const { return at != o.at ? at > o.at : seq > o.seq; }
+    };
+
+    SimConfig cfg;
+    mt19937_64 rng;
+    ShardedPatientStore patients;      // synthetic, never saved; narrow shards keep list scans short
+    AppointmentManager appts;
+    EmergencyManager emergencies;
+    DoctorDB roster;
+    DispatchEngine dispatcher;
+    vector<string> doctorNames;
+    unordered_map<string, int> doctorIndex;
+    priority_queue<SimEvent, vector<SimEvent>, greater<SimEvent>> events;
+    long long seq = 0;
+    long long endMs = 0;               // end of the simulated window
+
+    long long expMs(double meanMinutes) {
+        exponential_distribution<double> d(1.0 / max(meanMinutes, 1e-6));
+        return max(1LL, (long long)(d(rng) * 60000.0));
+    }
+    void push(long long at, EventKind k, int doctor = -1) { events.push({ at, seq++, k, doctor }); }
+    int randomPatient() { return 1 + (int)(rng() % (unsigned long long)cfg.population); }
+
+    // Emergencies first, then routine visits on whoever is still free.
+    void assign(long long now, SimResult& r, double& busyMs) {
+        for (const auto& d : dispatcher.dispatch(now)) {
+            long long service = expMs(cfg.emergencyServiceMin);
+            busyMs += (double)min(service, endMs - now);
+            push(now + service, ServiceDone, doctorIndex[d.doctor]);
+            r.emergencyWait.record((unsigned long long)d.waitedMs);
+            if (d.priority >= 8) r.urgentWait.record((unsigned long long)d.waitedMs);
+            ++r.emergencyServed;
+        }
+        string doctor;
+        while (appts.hasRoutine() && dispatcher.freeDoctors() > 0) {
+            Appointment a = appts.popNextRoutine(now);
+            dispatcher.occupyAny(a.patientId, doctor);
+            long long service = expMs(cfg.routineServiceMin);
+            busyMs += (double)min(service, endMs - now);
+            push(now + service, ServiceDone, doctorIndex[doctor]);
+            r.routineWait.record((unsigned long long)(now - a.arrival));
+            ++r.routineServed;
+        }
+    }
+
+public:
+    // Copies the doctor roster and ailment -> specialty policy so the live
+    // system is left untouched. Building and running the simulation records
+    // nothing into the live operation statistics (StatsPause).
+    HospitalSimulator(const SimConfig& c, const DoctorDB& doctors, const unordered_map<string, string>& ailmentMap)
+        : cfg(c), rng(c.seed), patients("sim.manifest", 256), roster(doctors),
+          dispatcher(emergencies, roster, patients) {
+        StatsPause pause;
+        cfg.population = max(1, cfg.population);
+        if (roster.doctorCount() == 0) {
+            for (int i = 1; i <= max(1, cfg.doctors); ++i) roster.addDoctor("SimDr" + to_string(i));
+        }
+        for (const auto& d : roster.listAllDoctors()) {
+            doctorIndex[d.first] = (int)doctorNames.size();
+            doctorNames.push_back(d.first);
+        }
+        for (const auto& kv : ailmentMap) dispatcher.setAilmentSpecialty(kv.first, kv.second);
+        emergencies.setAging(cfg.agingPerMinute);
+
+        vector<string> ailments = { "Flu", "Fever", "Injury", "Infection" };
+        for (const auto& kv : ailmentMap) ailments.push_back(kv.first);
+        for (int id = 1; id <= cfg.population; ++id) {
+            Patient p;
+            p.id = id;
+            p.name = "Sim" + to_string(id);
+            p.age = (int)(rng() % 90);
+            p.gender = rng() % 2 ? "M" : "F";
+            p.ailment = ailments[rng() % ailments.size()];
+            patients.addPatient(p);
+        }
+    }
+
+    int doctorCount() const { return (int)doctorNames.size(); }
+
+    void run(SimResult& r) {
+        StatsPause pause;
+        auto wallStart = chrono::steady_clock::now();
+        // the clock starts at 1 ms: an arrival of 0 means "stamp with wall time"
+        const long long start = 1;
+        const long long end = start + (long long)(cfg.hours * 3600000.0);
+        endMs = end;
+        double routineArea = 0, emergencyArea = 0, busyMs = 0;
+        long long last = start;
+        if (cfg.routinePerHour > 0) push(start + expMs(60.0 / cfg.routinePerHour), RoutineArrival);
+        if (cfg.emergencyPerHour > 0) push(start + expMs(60.0 / cfg.emergencyPerHour), EmergencyArrival);
+
+        uniform_int_distribution<int> priority(1, 10);
+        while (!events.empty() && events.top().at <= end) {
+            SimEvent ev = events.top();
+            events.pop();
+            ++r.events;
+            routineArea += (double)appts.size() * (ev.at - last);
+            emergencyArea += (double)emergencies.size() * (ev.at - last);
+            last = ev.at;
+
+            if (ev.kind == RoutineArrival) {
+                ++r.routineArrived;
+                int pid = randomPatient();
+                appts.scheduleRoutine(Appointment(pid, to_string(ev.at), "sim", ev.at));
+                push(ev.at + expMs(60.0 / cfg.routinePerHour), RoutineArrival);
+            }
+            else if (ev.kind == EmergencyArrival) {
+                ++r.emergencyArrived;
+                emergencies.scheduleEmergency(EmergencyItem(randomPatient(), priority(rng), "sim", ev.at));
+                push(ev.at + expMs(60.0 / cfg.emergencyPerHour), EmergencyArrival);
+            }
+            else dispatcher.release(doctorNames[ev.doctor]);
+
+            assign(ev.at, r, busyMs);
+            r.maxRoutineQueue = max(r.maxRoutineQueue, appts.size());
+            r.maxEmergencyQueue = max(r.maxEmergencyQueue, emergencies.size());
+        }
+        routineArea += (double)appts.size() * (end - last);
+        emergencyArea += (double)emergencies.size() * (end - last);
+
+        double span = (double)(end - start);
+        r.doctors = doctorCount();
+        r.avgRoutineQueue = span > 0 ? routineArea / span : 0;
+        r.avgEmergencyQueue = span > 0 ? emergencyArea / span : 0;
+        r.utilization = span > 0 ? busyMs / (span * max(1, r.doctors)) : 0;
+        r.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    }
+};
+
+// ---------------------------- Reporting & Analytics ----------------------
+// Merge sort for reports (sort patients by ID for report). Works on records
+// or on pointers into a snapshot, so reports need not copy every Patient.
+inline int patientKey(const Patient& p) { return p.id; }
+inline int patientKey(const Patient* p) { return p->id; }
+
+template <typename T>
+void merge(vector<T>& arr, int l, int m, int r) {
+    int n1 = m - l + 1;
+    int n2 = r - m;
+    vector<T> L(n1);
+    vector<T> R(n2);
+    for (int i = 0; i < n1; ++i) L[i] = arr[l + i];
+    for (int j = 0; j < n2; ++j) R[j] = arr[m + 1 + j];
+    int i = 0, j = 0, k = l;
+    while (i < n1 && j < n2) {
+        if (patientKey(L[i]) <= patientKey(R[j])) arr[k++] = L[i++];
+        else arr[k++] = R[j++];
+    }
+    while (i < n1) arr[k++] = L[i++];
+    while (j < n2) arr[k++] = R[j++];
+}
+
+template <typename T>
+void mergeSort(vector<T>& arr, int l, int r) {
+    if (l < r) {
+        int m = l + (r - l) / 2;
+        mergeSort(arr, l, m);
+        mergeSort(arr, m + 1, r);
+        merge(arr, l, m, r);
+    }
+}
+
+// BST for hierarchical data (e.g., ailment counts)
+class AnalyticsNode {
+public:
+    string key;
+    int count;
+    AnalyticsNode* left, * right;
+    AnalyticsNode(const string& k) : key(k), count(1), left(nullptr), right(nullptr) {}
+};
+
+class AnalyticsTree {
+private:
+    AnalyticsNode* root;
+    void insertRec(AnalyticsNode*& node, const string& key) {
+        if (!node) {
+            node = new AnalyticsNode(key);
+            return;
+        }
+        if (key == node->key) node->count++;
+        else if (key < node->key) insertRec(node->left, key);
+        else insertRec(node->right, key);
+    }
+    void inorderRec(AnalyticsNode* node) const {
+        if (!node) return;
+        inorderRec(node->left);
+        cout << setw(25) << node->key << " : " << node->count << '\n';
+        inorderRec(node->right);
+    }
+    void freeRec(AnalyticsNode* node) {
+        if (!node) return;
+        freeRec(node->left);
+        freeRec(node->right);
+        delete node;
+    }
+public:
+    AnalyticsTree() : root(nullptr) {}
+    ~AnalyticsTree() { freeRec(root); }
+    void insert(const string& key) { insertRec(root, key); }
+    void displayInorder() const {
+        cout << "Analytics (key : count)\n";
+        cout << string(40, '-') << '\n';
+        inorderRec(root);
+        cout << string(40, '-') << '\n';
+    }
+};
+
+// Report generator
+class ReportGenerator {
+public:
+    // Reads a frozen snapshot; the patient list can keep changing meanwhile.
+    template <typename Snapshot>
+    static void patientReport(const Snapshot& snap) {
+        static LatencyHistogram& hist = opStats("reports.patientReport");
+        ScopedTimer timer(hist);
+        if (snap.empty()) {
+            cout << "No patient data to generate report.\n";
+            return;
+        }
+        vector<const Patient*> sorted;
+        sorted.reserve(snap.size());
+        snap.forEach([&](const Patient& p) { sorted.push_back(&p); });
+        mergeSort(sorted, 0, (int)sorted.size() - 1);
+        cout << "Patient Report (sorted by ID, version " << snap.version() << "):\n";
+        cout << left << setw(6) << "ID" << setw(20) << "Name" << setw(15) << "Ailment" << setw(9) << "Priority" << setw(6) << "Age" << '\n';
+        cout << string(60, '-') << '\n';
+        for (const Patient* p : sorted) {
+            cout << setw(6) << p->id << setw(20) << p->name << setw(15) << p->ailment << setw(9) << p->priority << setw(6) << p->age << '\n';
+        }
+        // simple stats
+        int total = (int)sorted.size();
+        double sumAge = 0;
+        unordered_map<string, int> genderCount;
+        unordered_map<string, int> ailmentCount;
+        for (const Patient* p : sorted) {
+            sumAge += p->age;
+            genderCount[p->gender]++;
+            ailmentCount[p->ailment]++;
+        }
+        cout << "\nStatistics:\n";
+        cout << "Total patients: " << total << '\n';
+        cout << "Average age: " << fixed << setprecision(2) << (sumAge / total) << '\n';
+        cout << "By gender:\n";
+        for (auto& kv : genderCount) cout << "  " << kv.first << " : " << kv.second << '\n';
+        // top ailments
+        vector<pair<int, string>> ailVec;
+        for (auto& kv : ailmentCount) ailVec.push_back({ kv.second, kv.first });
+        int top = min(3, (int)ailVec.size());
+        partial_sort(ailVec.begin(), ailVec.begin() + top, ailVec.end(), greater<pair<int, string>>());
+        cout << "Top ailments:\n";
+        for (int i = 0; i < top; ++i) {
+            cout << "  " << ailVec[i].second << " : " << ailVec[i].first << '\n';
+        }
+    }
+
+    // Report over patient files that may not fit in memory: one pass sorts
+    // bounded runs and gathers the statistics, then heaps of at most
+    // MERGE_FAN_IN runs merge them, in several passes if needed.
+    static void streamingPatientReport(const vector<string>& files, size_t memoryCap) {
+        static LatencyHistogram& hist = opStats("reports.streamingReport");
+        ScopedTimer timer(hist);
+        int total = 0;
+        double sumAge = 0;
+        unordered_map<string, int> genderCount;
+        unordered_map<string, int> ailmentCount;
+        TempFileSet runs;
+        bool written = writeSortedRuns(files, memoryCap, "report_run_", runs, [&](const Patient& p) {
+            ++total;
+            sumAge += p.age;
+            genderCount[p.gender]++;
+            ailmentCount[p.ailment]++;
+        });
+        if (!written) {
+            cout << "Could not read the patient files or write the temporary sorted runs.\n";
+            return;
+        }
+        size_t runCount = runs.files.size();
+        vector<string> toMerge = runs.files;
+        if (!mergeRunsBounded(toMerge, MERGE_FAN_IN, "report_merge_", runs)) {
+            cout << "Could not merge the temporary sorted runs.\n";
+            return;
+        }
+        if (total == 0) {
+            cout << "No patient data to generate report.\n";
+            return;
+        }
+        PatientMergeStream merged(toMerge);
+        if (!merged.ok()) {
+            cout << "Could not open the temporary sorted runs.\n";
+            return;
+        }
+        cout << "Patient Report (sorted by ID, " << runCount << " sorted runs):\n";
+        cout << left << setw(6) << "ID" << setw(20) << "Name" << setw(15) << "Ailment" << setw(9) << "Priority" << setw(6) << "Age" << '\n';
+        cout << string(60, '-') << '\n';
+        Patient p;
+        int src, listed = 0;
+        while (merged.next(p, src)) {
+            cout << setw(6) << p.id << setw(20) << p.name << setw(15) << p.ailment << setw(9) << p.priority << setw(6) << p.age << '\n';
+            ++listed;
+        }
+        if (!merged.ok() || listed != total) {
+            cout << "Report incomplete: " << listed << " of " << total << " patients could be read back.\n";
+            return;
+        }
+        cout << "\nStatistics:\n";
+        cout << "Total patients: " << total << '\n';
+        cout << "Average age: " << fixed << setprecision(2) << (sumAge / total) << '\n';
+        cout << "By gender:\n";
+        for (auto& kv : genderCount) cout << "  " << kv.first << " : " << kv.second << '\n';
+        // top ailments: partial sort, only 3 are needed
+        vector<pair<int, string>> ailVec;
+        for (auto& kv : ailmentCount) ailVec.push_back({ kv.second, kv.first });
+        int top = min(3, (int)ailVec.size());
+        partial_sort(ailVec.begin(), ailVec.begin() + top, ailVec.end(), greater<pair<int, string>>());
+        cout << "Top ailments:\n";
+        for (int i = 0; i < top; ++i) {
+            cout << "  " << ailVec[i].second << " : " << ailVec[i].first << '\n';
+        }
+    }
+
+    template <typename Snapshot>
+    static void analyticsByAilment(const Snapshot& snap) {
+        static LatencyHistogram& hist = opStats("reports.analyticsByAilment");
+        ScopedTimer timer(hist);
+        if (snap.empty()) {
+            cout << "No data available.\n";
+            return;
+        }
+        AnalyticsTree tree;
+        snap.forEach([&](const Patient& p) { tree.insert(p.ailment); });
+        tree.displayInorder();
+    }
+
+    // Rolling throughput and waits of a queue, read from its pre-aggregated
+    // time series (the popped items themselves are gone).
+    static void queueReport(const string& title, const QueueTimeSeries& ts, long long nowMs) {
+        static LatencyHistogram& hist = opStats("reports.queueReport");
+        ScopedTimer timer(hist);
+        auto row = [](const string& label, const QueueWindow& w) {
+            cout << left << setw(10) << label << right << setw(9) << w.arrivals << setw(9) << w.served
+                << fixed << setprecision(1) << setw(9) << w.perHour(w.arrivals) << setw(9) << w.perHour(w.served)
+                << setw(10) << formatWait(w.waits.percentile(0.50)) << setw(9) << formatWait(w.waits.percentile(0.90))
+                << setw(9) << formatWait(w.waits.percentile(0.99)) << setw(9) << formatWait(w.waits.max())
+                << setw(7) << w.peakDepth << '\n';
+        };
+        cout << '\n' << title << " - arrivals, service and waits\n";
+        cout << left << setw(10) << "Window" << right << setw(9) << "Arrived" << setw(9) << "Served"
+            << setw(9) << "In/h" << setw(9) << "Out/h" << setw(10) << "Wait p50" << setw(9) << "p90"
+            << setw(9) << "p99" << setw(9) << "max" << setw(7) << "Peak" << '\n';
+        const long long MIN = QueueTimeSeries::MINUTE_MS, HOUR = QueueTimeSeries::HOUR_MS;
+        row("15 min", ts.window(nowMs, 15 * MIN));
+        row("1 hour", ts.window(nowMs, HOUR));
+        row("24 hours", ts.window(nowMs, 24 * HOUR));
+        cout << "By hour (most recent last):\n";
+        vector<QueueWindow> hours = ts.buckets(nowMs, HOUR, 12);
+        for (size_t i = 0; i < hours.size(); ++i) {
+            size_t ago = hours.size() - 1 - i;
+            if (hours[i].arrivals == 0 && hours[i].served == 0) continue;
+            row(ago == 0 ? "current" : "-" + to_string(ago) + "h", hours[i]);
+        }
+        cout << left;
+    }
+
+private:
+    static string formatWait(unsigned long long ms) {
+        ostringstream oss;
+        oss << fixed << setprecision(1);
+        if (ms < 1000) oss << ms << "ms";
+        else if (ms < 60000) oss << ms / 1000.0 << 's';
+        else if (ms < 3600000) oss << ms / 60000.0 << 'm';
+        else oss << ms / 3600000.0 << 'h';
+        return oss.str();
+    }
+};
+
+// ---------------------------- Patient Import (k-way merge) ---------------
+// Consolidates several patients.txt-format exports into the store. Each
+// input is used as a sorted run directly when already ordered by id, and
+// otherwise sorted externally. All runs, plus the current store contents as
+// the oldest source, are merged by id with heaps of at most MERGE_FAN_IN
+// runs; duplicates are resolved by the policy into one merged run, which is
+// checked and then bulk-loaded in one linear pass.
+enum class ImportPolicy { NewestWins, KeepFirst, ReportConflicts };
+
+struct ImportResult {
+    long long rowsRead = 0;
+    long long imported = 0;     // records in the store afterwards
+    long long conflicts = 0;    // duplicate ids resolved by the policy
+    string error;               // set when the import failed; the store is unchanged unless
+                                // the error says it was reloaded
+
+    bool ok() const { return error.empty(); }
+};
+
+inline bool fileSortedById(const string& filename) {
+    PatientFileReader r(filename);
+    if (!r.valid()) return true;
+    int prev = r.current().id;
+    for (r.advance(); r.valid(); r.advance()) {
+        if (r.current().id < prev) return false;
+        prev = r.current().id;
+    }
+    return true;
+}
+
+// Sources are ranked by position: 0 is the existing store, then files in
+// the given order, so "newest" means later in the list. Conflicts are
+// written to conflictFile as id|keptSource|droppedSource|droppedRecord.
+// At most MERGE_FAN_IN - 1 files can be imported at once. The store is left
+// alone if any shard is damaged (it would be rebuilt without that shard's
+// records) or if any run cannot be read back in full.
+inline ImportResult importPatientFiles(ShardedPatientStore& store, const vector<string>& files,
+    ImportPolicy policy, size_t memoryCap, const string& conflictFile = "import_conflicts.txt") {
+    static LatencyHistogram& hist = opStats("patients.import");
+    ScopedTimer timer(hist);
+    ImportResult res;
+    TempFileSet temps;
+    vector<vector<string>> sourceRuns(files.size() + 1);     // sorted runs per source
+    long long expected = 0;                                    // records going into the merge
+
+    if (sourceRuns.size() > MERGE_FAN_IN) {
+        res.error = "at most " + to_string(MERGE_FAN_IN - 1) + " files per import";
+        return res;
+    }
+    // a missing input must not look like an empty one
+    for (const auto& file : files) {
+        ifstream probe(file, ios::binary);
+        if (!probe) {
+            res.error = "cannot open " + file;
+            return res;
+        }
+    }
+
+    // source 0: the current store, written as one sorted run
+    {
+        PatientSnapshot snap = store.snapshot();
+        vector<string> damaged = store.damagedShardFiles();
+        if (!damaged.empty()) {
+            res.error = "patient shard " + damaged.front() + " is damaged; repair it before importing";
+            return res;
+        }
+        vector<const Patient*> v;
+        v.reserve(snap.size());
+        snap.forEach([&](const Patient& p) { v.push_back(&p); });
+        sort(v.begin(), v.end(), [](const Patient* a, const Patient* b) { return a->id < b->id; });
+        temps.files.push_back("import_existing.tmp");
+        ofstream fout(temps.files.back());
+        for (const Patient* p : v) fout << p->serialize() << '\n';
+        bool written = (bool)fout;
+        fout.close();
+        if (!written || !fout) {
+            res.error = "cannot write " + temps.files.back();
+            return res;
+        }
+        sourceRuns[0].push_back(temps.files.back());
+        expected += (long long)v.size();
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        int src = (int)i + 1;
+        if (fileSortedById(files[i])) {
+            PatientFileReader r(files[i]);
+            for (; r.valid(); r.advance()) ++res.rowsRead;
+            if (!r.ok()) {
+                res.error = "cannot read " + files[i];
+                return res;
+            }
+            sourceRuns[src].push_back(files[i]);
+            continue;
+        }
+        size_t before = temps.files.size();
+        if (!writeSortedRuns({ files[i] }, memoryCap, "import_run_" + to_string(src) + "_", temps,
+                [&](const Patient&) { ++res.rowsRead; })) {
+            res.error = "cannot read " + files[i] + " or write its sorted runs";
+            return res;
+        }
+        sourceRuns[src].assign(temps.files.begin() + before, temps.files.end());
+    }
+    expected += res.rowsRead;
+
+    // Each source's runs are merged down to its share of the fan-in; runs of
+    // one source hold no ids of another, so source order survives.
+    vector<string> runs;
+    vector<int> runSource;
+    size_t share = MERGE_FAN_IN / sourceRuns.size();
+    for (size_t src = 0; src < sourceRuns.size(); ++src) {
+        if (!mergeRunsBounded(sourceRuns[src], share, "import_merge_" + to_string(src) + "_", temps)) {
+            res.error = "cannot merge the sorted runs of source " + to_string(src);
+            return res;
+        }
+        for (const auto& run : sourceRuns[src]) {
+            runs.push_back(run);
+            runSource.push_back((int)src);
+        }
+    }
+
+    ofstream log;
+    if (policy == ImportPolicy::ReportConflicts) log.open(conflictFile);
+
+    // Equal ids arrive consecutively, in source order within each id.
+    PatientMergeStream merged(runs);
+    temps.files.push_back("import_merged.tmp");
+    ofstream out(temps.files.back());
+    Patient pending, p;
+    int pendingSrc = -1, run;
+    bool hasPending = merged.next(pending, run);
+    if (hasPending) pendingSrc = runSource[run];
+    while (hasPending) {
+        hasPending = merged.next(p, run);
+        if (hasPending && p.id == pending.id) {
+            int src = runSource[run];
+            ++res.conflicts;
+            if (policy == ImportPolicy::NewestWins) {
+                pending = p;
+                pendingSrc = src;
+            }
+            else if (log.is_open()) {
+                log << p.id << '|' << pendingSrc << '|' << src << '|' << p.serialize() << '\n';
+            }
+            continue;
+        }
+        out << pending.serialize() << '\n';
+        ++res.imported;
+        if (hasPending) {
+            pending = p;
+            pendingSrc = runSource[run];
+        }
+    }
+    out.close();
+    if (!out || !merged.ok() || res.imported + res.conflicts != expected) {
+        res.error = "merge read " + to_string(res.imported + res.conflicts) + " of " + to_string(expected) + " records";
+        res.imported = 0;
+        return res;
+    }
+
+    long long loaded = 0;
+    PatientFileReader in(temps.files.back());
+    store.bulkLoadSorted([&](Patient& rec) {
+        if (!in.valid()) return false;
+        rec = in.current();
+        in.advance();
+        ++loaded;
+        return true;
+    });
+    if (!in.ok() || loaded != res.imported)
+        res.error = "store reloaded with " + to_string(loaded) + " of " + to_string(res.imported) + " records";
+    return res;
+}
+
+// ---------------------------- Batch Command Mode ---------------------------
+// Headless mode for feeds: one command per line, fields separated by '|'.
+//   add|id|name|age|gender|ailment|priority|phone|doctor
+//   update|id|name|age|gender|ailment|priority|phone|doctor
+//   remove|id                    find|id
+//   schedule|patientId|timeSlot|notes
+//   emergency|patientId|priority|notes
+//   pop-routine                  pop-emergency
+//   doctor|name                  availability|doctor|timeSlot
+//   staff|name|role              import|newest|keep-first|report|file1|file2...
+//   save                         load                  stats
+//   format|text|packed           (write format for patients and emergencies)
+//   trending|admissions|minutes|k   trending|emergencies|minutes|k
+//   memory                       budget|megabytes      (0 = no limit)
+//   throughput|emergencies|minutes  throughput|appointments|minutes
+// Blank lines and lines starting with '#' are skipped. Every command yields
+// one line: "ok|<command>[|result]" or "err|<line number>|<message>".
+// Consecutive adds are applied together through the bulk insert path.
+// When several processors share the managers (server mode), managersLock
+// serialises the appointment/emergency/doctor commands; patient commands
+// rely on the store's own locking. load, import and format replace or
+// rewrite the whole store and are refused unless allowReload is set.
+class BatchProcessor {
+private:
+    ShardedPatientStore& plist;
+    AppointmentManager& am;
+    EmergencyManager& em;
+    DoctorDB& db;
+    ostream& out;
+    mutex* managersLock;
+    bool allowReload;
+    vector<Patient> pendingAdds;
+    vector<long long> pendingLines;
+    long long okCount = 0, errCount = 0;
+
+    void ok(const string& cmd, const string& result = "") {
+        ++okCount;
+        out << "ok|" << cmd;
+        if (!result.empty()) out << '|' << result;
+        out << '\n';
+    }
+    void err(long long lineNo, const string& msg) {
+        ++errCount;
+        out << "err|" << lineNo << '|' << msg << '\n';
+    }
+
+    // A patient command failed: either because of id itself (msg) or
+    // because its shard is damaged and refuses all operations.
+    void patientErr(long long lineNo, int id, const string& msg) {
+        string file;
+        if (plist.damagedShardFor(id, file)) err(lineNo, "patient shard damaged, repair " + file);
+        else err(lineNo, msg + " " + to_string(id));
+    }
+
+    void flushAdds() {
+        if (pendingAdds.empty()) return;
+        vector<char> added;
+        plist.addBatch(pendingAdds, added);
+        for (size_t i = 0; i < pendingAdds.size(); ++i) {
+            if (added[i]) ok("add", to_string(pendingAdds[i].id));
+            else patientErr(pendingLines[i], pendingAdds[i].id, "duplicate patient id");
+        }
+        pendingAdds.clear();
+        pendingLines.clear();
+    }
+
+    static bool parseInt(const string& s, int& v) {
+        try {
+            size_t used;
+            v = stoi(s, &used);
+            return used == s.size();
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    void execute(long long lineNo, const string& line) {
+        size_t bar = line.find('|');
+        string cmd = line.substr(0, bar);
+        string rest = bar == string::npos ? "" : line.substr(bar + 1);
+        if (cmd == "add") {
+            Patient p;
+            if (!Patient::deserialize(rest, p)) {
+                flushAdds();    // keep responses in line order
+                err(lineNo, "malformed patient record");
+                return;
+            }
+            pendingAdds.push_back(p);
+            pendingLines.push_back(lineNo);
+            if (pendingAdds.size() >= 65536) flushAdds();
+            return;
+        }
+        flushAdds();    // everything else must see the adds before it
+        vector<string> f = splitFields(rest);
+        int id = 0;
+        if (cmd == "update") {
+            Patient p;
+            if (!Patient::deserialize(rest, p)) err(lineNo, "malformed patient record");
+            else if (plist.updatePatient(p)) ok(cmd, to_string(p.id));
+            else patientErr(lineNo, p.id, "patient not found");
+            return;
+        }
+        if (cmd == "remove" || cmd == "find") {
+            if (!parseInt(f[0], id)) { err(lineNo, "bad patient id"); return; }
+            if (cmd == "remove") {
+                if (plist.removeById(id)) ok(cmd, to_string(id));
+                else patientErr(lineNo, id, "patient not found");
+            }
+            else {
+                Patient p;
+                if (plist.getById(id, p)) ok(cmd, p.serialize());
+                else patientErr(lineNo, id, "patient not found");
+            }
+            return;
+        }
+        if (cmd == "trending") {
+            int minutes = 60, k = 5;
+            bool sourceOk = f[0] == "admissions" || f[0] == "emergencies";
+            if (!sourceOk || (f.size() > 1 && !parseInt(f[1], minutes)) || (f.size() > 2 && !parseInt(f[2], k))
+                || minutes < 1 || k < 1) {
+                err(lineNo, "expected trending|admissions|emergencies|minutes|k");
+                return;
+            }
+            AilmentTrends* trends = plist.trendSink();
+            if (!trends) { err(lineNo, "trends are not recorded here"); return; }
+            unsigned long long total = 0;
+            vector<AilmentTrend> t = trends->top(f[0] == "admissions" ? TrendSource::Admissions : TrendSource::Emergencies,
+                nowMillis(), (long long)minutes * 60000, k, total);
+            string result = to_string(total);
+            for (const auto& a : t) result += '|' + a.ailment + ':' + to_string(a.count);
+            ok(cmd, result);
+            return;
+        }
+        if (cmd == "memory") {
+            MemoryUsage u = plist.memoryUsage();
+            ok(cmd, to_string(u.records) + '|' + to_string(u.strings) + '|' + to_string(u.nodes) + '|'
+                + to_string(u.index) + '|' + to_string(u.total()) + '|' + to_string(plist.memoryBudget()) + '|'
+                + to_string(plist.loadedShardCount()) + '|' + to_string(plist.shardLoadCount()) + '|'
+                + to_string(plist.evictionCount()));
+            return;
+        }
+        if (cmd == "budget") {
+            int mb = 0;
+            if (!parseInt(f[0], mb) || mb < 0) { err(lineNo, "expected budget|megabytes"); return; }
+            plist.setMemoryBudget((size_t)mb * 1024 * 1024);
+            ok(cmd, to_string(mb));
+            return;
+        }
+        if (cmd == "throughput") {
+            // the time series lock themselves; no need for managersLock
+            int minutes = 60;
+            bool sourceOk = f[0] == "emergencies" || f[0] == "appointments";
+            if (!sourceOk || (f.size() > 1 && !parseInt(f[1], minutes)) || minutes < 1) {
+                err(lineNo, "expected throughput|emergencies|appointments|minutes");
+                return;
+            }
+            const QueueTimeSeries& ts = f[0] == "emergencies" ? em.history() : am.history();
+            QueueWindow w = ts.window(nowMillis(), (long long)minutes * 60000);
+            ok(cmd, to_string(w.arrivals) + '|' + to_string(w.served) + '|' + to_string(w.waits.percentile(0.50))
+                + '|' + to_string(w.waits.percentile(0.90)) + '|' + to_string(w.waits.percentile(0.99))
+                + '|' + to_string(w.waits.max()) + '|' + to_string(w.peakDepth));
+            return;
+        }
+        unique_lock<mutex> lk;
+        if (managersLock) lk = unique_lock<mutex>(*managersLock);
+        if ((cmd == "load" || cmd == "import" || cmd == "format") && !allowReload) {
+            err(lineNo, cmd + " is not available here");
+        }
+        else if (cmd == "schedule") {
+            if (f.size() < 3 || !parseInt(f[0], id)) { err(lineNo, "expected schedule|patientId|timeSlot|notes"); return; }
+            if (!plist.contains(id)) { patientErr(lineNo, id, "patient not found"); return; }
+            am.scheduleRoutine(Appointment(id, f[1], fieldsAfter(rest, 2)));
+            ok(cmd, to_string(id));
+        }
+        else if (cmd == "emergency") {
+            int pr = 0;
+            if (f.size() < 3 || !parseInt(f[0], id) || !parseInt(f[1], pr)) {
+                err(lineNo, "expected emergency|patientId|priority|notes");
+                return;
+            }
+            if (!plist.contains(id)) { patientErr(lineNo, id, "patient not found"); return; }
+            em.scheduleEmergency(EmergencyItem(id, pr, fieldsAfter(rest, 2)));
+            ok(cmd, to_string(id));
+        }
+        else if (cmd == "pop-routine") {
+            if (!am.hasRoutine()) { err(lineNo, "no routine appointments"); return; }
+            ok(cmd, am.popNextRoutine().serialize());
+        }
+        else if (cmd == "pop-emergency") {
+            if (!em.hasEmergency()) { err(lineNo, "no emergencies"); return; }
+            ok(cmd, em.popNextEmergency().serialize());
+        }
+        else if (cmd == "doctor") {
+            if (rest.empty()) { err(lineNo, "expected doctor|name"); return; }
+            db.addDoctor(rest);
+            ok(cmd, rest);
+        }
+        else if (cmd == "availability") {
+            if (f.size() < 2) { err(lineNo, "expected availability|doctor|timeSlot"); return; }
+            if (db.addAvailability(f[0], f[1])) ok(cmd, f[0]);
+            else err(lineNo, "doctor not found " + f[0]);
+        }
+        else if (cmd == "staff") {
+            if (f.size() < 2) { err(lineNo, "expected staff|name|role"); return; }
+            db.addStaff(f[0], f[1]);
+            ok(cmd, f[0]);
+        }
+        else if (cmd == "import") {
+            if (f.size() < 2) { err(lineNo, "expected import|policy|file..."); return; }
+            ImportPolicy policy;
+            if (f[0] == "newest") policy = ImportPolicy::NewestWins;
+            else if (f[0] == "keep-first") policy = ImportPolicy::KeepFirst;
+            else if (f[0] == "report") policy = ImportPolicy::ReportConflicts;
+            else { err(lineNo, "unknown import policy " + f[0]); return; }
+            ImportResult r = importPatientFiles(plist, vector<string>(f.begin() + 1, f.end()), policy,
+                (size_t)64 * 1024 * 1024);
+            if (!r.ok()) { err(lineNo, "import failed: " + r.error); return; }
+            ok(cmd, to_string(r.rowsRead) + '|' + to_string(r.imported) + '|' + to_string(r.conflicts));
+        }
+        else if (cmd == "save") {
+            bool all = plist.saveToFile() & am.saveToFile() & em.saveToFile() & db.saveDoctors() & db.saveStaff();
+            if (all) ok(cmd); else err(lineNo, "save failed");
+        }
+        else if (cmd == "load") {
+            bool all = plist.loadFromFile() & am.loadFromFile() & em.loadFromFile() & db.loadDoctors() & db.loadStaff();
+            if (all) ok(cmd); else err(lineNo, "some files could not be loaded");
+        }
+        else if (cmd == "format") {
+            if (f.size() < 1 || (f[0] != "text" && f[0] != "packed")) { err(lineNo, "expected format|text|packed"); return; }
+            StorageFormat fmt = f[0] == "packed" ? StorageFormat::Packed : StorageFormat::Text;
+            plist.setFormat(fmt);
+            em.setFormat(fmt);
+            ok(cmd, f[0]);
+        }
+        else if (cmd == "stats") {
+            ostringstream json;
+            StatsRegistry::instance().writeJson(json);
+            string j = json.str();
+            if (!j.empty() && j.back() == '\n') j.pop_back();
+            ok(cmd, j);
+        }
+        else err(lineNo, "unknown command " + cmd);
+    }
+
+public:
+    BatchProcessor(ShardedPatientStore& p, AppointmentManager& a, EmergencyManager& e, DoctorDB& d, ostream& o,
+        mutex* managers = nullptr, bool reload = true)
+        : plist(p), am(a), em(e), db(d), out(o), managersLock(managers), allowReload(reload) {}
+
+    long long succeeded() const { return okCount; }
+    long long failed() const { return errCount; }
+
+    // Handles one command line; results of buffered adds appear at finish()
+    // or before the next non-add command.
+    void runLine(long long lineNo, string line) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') return;
+        execute(lineNo, line);
+    }
+
+    void finish() { flushAdds(); }
+
+    void run(istream& in) {
+        string line;
+        long long lineNo = 0;
+        while (getline(in, line)) runLine(++lineNo, line);
+        finish();
     }
+};
 
-    // Staff functions
-    void addStaff(const string& name, const string& role) { staff[name] = role; }
-    bool removeStaff(const string& name) {
-        auto it = staff.find(name);
-        if (it == staff.end()) return false;
-        staff.erase(it);
-        return true;
+// ---------------------------- Socket Server (Linux) -----------------------
+// Serves the batch command protocol over a Unix domain socket so several
+// workstations share one copy of the data. One epoll thread does all socket
+// I/O; complete request lines go to a worker pool. Clients may pipeline any
+// number of requests: each connection has at most one task in flight, so
+// its responses come back in request order, while different connections are
+// served in parallel.
+#ifdef __linux__
+class WorkerPool {
+private:
+    vector<thread> threads;
+    queue<function<void()>> tasks;
+    mutex mtx;
+    condition_variable cv;
+    bool stopping;
+public:
+    explicit WorkerPool(int n) : stopping(false) {
+        for (int i = 0; i < max(1, n); ++i) {
+            threads.emplace_back([this]() {
+                while (true) {
+                    function<void()> task;
+                    {
+                        unique_lock<mutex> lk(mtx);
+                        cv.wait(lk, [this]() { return stopping || !tasks.empty(); });
+                        if (tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
     }
-    vector<pair<string, string>> listAllStaff() const {
-        vector<pair<string, string>> out;
-        for (const auto& kv : staff) out.push_back(kv);
-        return out;
+    ~WorkerPool() { shutdown(); }
+    // Runs the tasks already queued, then joins the workers; safe to repeat.
+    void shutdown() {
+        {
+            lock_guard<mutex> lk(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& t : threads)
+            if (t.joinable()) t.join();
     }
-
-    // persistence: doctors and staff in separate files
-    bool saveDoctors(const string& filename = "doctors.txt") const {
-        ofstream fout(filename);
-        if (!fout.is_open()) return false;
-        // Format: doctor|slot1;slot2;slot3
-        for (const auto& kv : doctors) {
-            fout << kv.first << '|';
-            for (size_t i = 0; i < kv.second.size(); ++i) {
-                fout << kv.second[i];
-                if (i + 1 < kv.second.size()) fout << ';';
-            }
-            fout << '\n';
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lk(mtx);
+            tasks.push(std::move(task));
         }
-        fout.close();
-        return true;
+        cv.notify_one();
     }
+};
 
-    bool loadDoctors(const string& filename = "doctors.txt") {
-        ifstream fin(filename);
-        if (!fin.is_open()) return false;
-        doctors.clear();
-        string line;
-        while (getline(fin, line)) {
-            if (line.empty()) continue;
-            size_t pos = line.find('|');
-            if (pos == string::npos) continue;
-            string name = line.substr(0, pos);
-            string slots = line.substr(pos + 1);
-            vector<string> v;
-            string cur;
-            for (size_t i = 0; i <= slots.size(); ++i) {
-                if (i == slots.size() || slots[i] == ';') {
-                    if (!cur.empty()) v.push_back(cur);
-                    cur.clear();
+class SocketServer {
+private:
+    // A client that pipelines faster than it reads is paused (no reads, no
+    // new work) once this many response bytes are waiting for it.
+    static const size_t MAX_OUTBUF = 4 << 20;
+
+    struct Connection {
+        int fd;
+        string inBuf;               // bytes read, not yet split into lines
+        deque<string> lines;        // complete requests awaiting a worker
+        string outBuf;              // responses not yet written
+        bool busy = false;          // a worker task owns `processor`
+        bool peerClosed = false;
+        uint32_t events = EPOLLIN | EPOLLRDHUP;    // what epoll watches now
+        long long lineNo = 0;
+        ostringstream results;
+        unique_ptr<BatchProcessor> processor;
+        mutex mtx;                  // guards lines, outBuf, busy
+        explicit Connection(int f) : fd(f) {}
+    };
+
+    string path;
+    ShardedPatientStore& plist;
+    AppointmentManager& am;
+    EmergencyManager& em;
+    DoctorDB& db;
+    mutex managersMtx;
+    int listenFd = -1, epfd = -1, wakeFd = -1;
+    map<int, shared_ptr<Connection>> conns;
+    atomic<long long> opsDone;
+    WorkerPool pool;
+
+    static bool setNonBlocking(int fd) {
+        int fl = fcntl(fd, F_GETFL, 0);
+        return fl >= 0 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) == 0;
+    }
+
+    void wake() {
+        unsigned long long one = 1;
+        ssize_t r = ::write(wakeFd, &one, sizeof(one));
+        (void)r;
+    }
+
+    // Worker side: drains the connection's queued lines in order.
+    void process(shared_ptr<Connection> c) {
+        while (true) {
+            deque<string> batch;
+            {
+                lock_guard<mutex> lk(c->mtx);
+                if (c->lines.empty() || c->outBuf.size() >= MAX_OUTBUF) {
+                    c->busy = false;    // flushClient resumes once outBuf drains
+                    break;
                 }
-                else cur.push_back(slots[i]);
+                batch.swap(c->lines);
             }
-            doctors[name] = v;
+            for (auto& line : batch) c->processor->runLine(++c->lineNo, line);
+            c->processor->finish();
+            opsDone += (long long)batch.size();
+            string res = c->results.str();
+            c->results.str("");
+            lock_guard<mutex> lk(c->mtx);
+            c->outBuf += res;
         }
-        fin.close();
-        return true;
+        wake();
     }
 
-    bool saveStaff(const string& filename = "staff.txt") const {
-        ofstream fout(filename);
-        if (!fout.is_open()) return false;
-        // Format: staffName|role
-        for (const auto& kv : staff) fout << kv.first << '|' << kv.second << '\n';
-        fout.close();
-        return true;
+    void closeConnection(int fd) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        conns.erase(fd);
     }
 
-    bool loadStaff(const string& filename = "staff.txt") {
-        ifstream fin(filename);
-        if (!fin.is_open()) return false;
-        staff.clear();
-        string line;
-        while (getline(fin, line)) {
-            if (line.empty()) continue;
-            size_t pos = line.find('|');
-            if (pos == string::npos) continue;
-            string name = line.substr(0, pos);
-            string role = line.substr(pos + 1);
-            staff[name] = role;
+    void acceptClients() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            auto c = make_shared<Connection>(fd);
+            c->processor = make_unique<BatchProcessor>(plist, am, em, db, c->results, &managersMtx, false);
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+            conns[fd] = c;
         }
-        fin.close();
-        return true;
     }
-};
 
-// ---------------------------- Reporting & Analytics ----------------------
-// Merge sort for reports (sort patients by ID for report)
-void merge(vector<Patient>& arr, int l, int m, int r) {
-    int n1 = m - l + 1;
-    int n2 = r - m;
-    vector<Patient> L(n1);
-    vector<Patient> R(n2);
-    for (int i = 0; i < n1; ++i) L[i] = arr[l + i];
-    for (int j = 0; j < n2; ++j) R[j] = arr[m + 1 + j];
-    int i = 0, j = 0, k = l;
-    while (i < n1 && j < n2) {
-        if (L[i].id <= R[j].id) arr[k++] = L[i++];
-        else arr[k++] = R[j++];
+    void readClient(const shared_ptr<Connection>& c) {
+        char buf[65536];
+        bool submit = false;
+        while (true) {
+            ssize_t n = ::read(c->fd, buf, sizeof(buf));
+            if (n > 0) {
+                c->inBuf.append(buf, (size_t)n);
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) c->peerClosed = true;
+            break;
+        }
+        size_t start = 0, nl;
+        {
+            lock_guard<mutex> lk(c->mtx);
+            while ((nl = c->inBuf.find('\n', start)) != string::npos) {
+                c->lines.push_back(c->inBuf.substr(start, nl - start));
+                start = nl + 1;
+            }
+            if (!c->busy && !c->lines.empty()) {
+                c->busy = true;
+                submit = true;
+            }
+        }
+        c->inBuf.erase(0, start);
+        if (submit) pool.submit([this, c]() { process(c); });
     }
-    while (i < n1) arr[k++] = L[i++];
-    while (j < n2) arr[k++] = R[j++];
-}
 
-void mergeSort(vector<Patient>& arr, int l, int r) {
-    if (l < r) {
-        int m = l + (r - l) / 2;
-        mergeSort(arr, l, m);
-        mergeSort(arr, m + 1, r);
-        merge(arr, l, m, r);
+    // Returns false once the connection has been closed.
+    bool flushClient(const shared_ptr<Connection>& c) {
+        unique_lock<mutex> lk(c->mtx);
+        while (!c->outBuf.empty()) {
+            ssize_t n = ::send(c->fd, c->outBuf.data(), c->outBuf.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                c->outBuf.erase(0, (size_t)n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            c->peerClosed = true;   // write error: drop what is left
+            c->outBuf.clear();
+        }
+        // stop reading after EOF (it would fire forever) or while the client
+        // is not collecting its responses; poll for writability only while
+        // responses are waiting
+        bool backlog = c->outBuf.size() >= MAX_OUTBUF;
+        uint32_t want = (c->peerClosed || backlog ? 0u : (uint32_t)(EPOLLIN | EPOLLRDHUP))
+            | (c->outBuf.empty() ? 0u : (uint32_t)EPOLLOUT);
+        if (want != c->events) {
+            epoll_event ev{};
+            ev.events = want;
+            ev.data.fd = c->fd;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+            c->events = want;
+        }
+        bool resume = !backlog && !c->busy && !c->lines.empty();
+        if (resume) c->busy = true;
+        bool open = !(c->peerClosed && !c->busy && c->lines.empty() && c->outBuf.empty());
+        lk.unlock();
+        if (resume) pool.submit([this, c]() { process(c); });
+        return open;
     }
-}
 
-// BST for hierarchical data (e.g., ailment counts)
-class AnalyticsNode {
 public:
-    string key;
-    int count;
-    AnalyticsNode* left, * right;
-    AnalyticsNode(const string& k) : key(k), count(1), left(nullptr), right(nullptr) {}
-};
+    SocketServer(const string& socketPath, ShardedPatientStore& p, AppointmentManager& a, EmergencyManager& e,
+        DoctorDB& d, int workers)
+        : path(socketPath), plist(p), am(a), em(e), db(d), opsDone(0), pool(workers) {}
 
-class AnalyticsTree {
-private:
-    AnalyticsNode* root;
-    void insertRec(AnalyticsNode*& node, const string& key) {
-        if (!node) {
-            node = new AnalyticsNode(key);
-            return;
+    ~SocketServer() {
+        pool.shutdown();    // workers write to wakeFd and client sockets
+        for (auto& kv : conns) ::close(kv.first);
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            ::unlink(path.c_str());
         }
-        if (key == node->key) node->count++;
-        else if (key < node->key) insertRec(node->left, key);
-        else insertRec(node->right, key);
-    }
-    void inorderRec(AnalyticsNode* node) const {
-        if (!node) return;
-        inorderRec(node->left);
-        cout << setw(25) << node->key << " : " << node->count << '\n';
-        inorderRec(node->right);
-    }
-    void freeRec(AnalyticsNode* node) {
-        if (!node) return;
-        freeRec(node->left);
-        freeRec(node->right);
-        delete node;
+        if (epfd >= 0) ::close(epfd);
+        if (wakeFd >= 0) ::close(wakeFd);
     }
-public:
-    AnalyticsTree() : root(nullptr) {}
-    ~AnalyticsTree() { freeRec(root); }
-    void insert(const string& key) { insertRec(root, key); }
-    void displayInorder() const {
-        cout << "Analytics (key : count)\n";
-        cout << string(40, '-') << '\n';
-        inorderRec(root);
-        cout << string(40, '-') << '\n';
+
+    bool start() {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(path.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return false;
+        if (::bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 512) < 0) return false;
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epfd < 0 || wakeFd < 0) return false;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listenFd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.data.fd = wakeFd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+        return true;
     }
-};
 
-// Report generator
-class ReportGenerator {
-public:
-    static void patientReport(const vector<Patient>& patients) {
-        if (patients.empty()) {
-            cout << "No patient data to generate report.\n";
-            return;
-        }
-        vector<Patient> copy = patients;
-        mergeSort(copy, 0, (int)copy.size() - 1);
-        cout << "Patient Report (sorted by ID):\n";
-        cout << left << setw(6) << "ID" << setw(20) << "Name" << setw(15) << "Ailment" << setw(9) << "Priority" << setw(6) << "Age" << '\n';
-        cout << string(60, '-') << '\n';
-        for (const auto& p : copy) {
-            cout << setw(6) << p.id << setw(20) << p.name << setw(15) << p.ailment << setw(9) << p.priority << setw(6) << p.age << '\n';
-        }
-        // simple stats
-        int total = (int)copy.size();
-        double sumAge = 0;
-        unordered_map<string, int> genderCount;
-        unordered_map<string, int> ailmentCount;
-        for (const auto& p : copy) {
-            sumAge += p.age;
-            genderCount[p.gender]++;
-            ailmentCount[p.ailment]++;
-        }
-        cout << "\nStatistics:\n";
-        cout << "Total patients: " << total << '\n';
-        cout << "Average age: " << fixed << setprecision(2) << (sumAge / total) << '\n';
-        cout << "By gender:\n";
-        for (auto& kv : genderCount) cout << "  " << kv.first << " : " << kv.second << '\n';
-        // top ailments
-        vector<pair<int, string>> ailVec;
-        for (auto& kv : ailmentCount) ailVec.push_back({ kv.second, kv.first });
-        sort(ailVec.rbegin(), ailVec.rend());
-        cout << "Top ailments:\n";
-        for (int i = 0; i < min(3, (int)ailVec.size()); ++i) {
-            cout << "  " << ailVec[i].second << " : " << ailVec[i].first << '\n';
+    long long operations() const { return opsDone.load(); }
+
+    // Runs until stop becomes true, then waits for the requests already
+    // handed to workers. Every reportEverySec seconds (0 = never) the
+    // request rate is printed to report.
+    void run(const atomic<bool>& stop, int reportEverySec = 0, ostream& report = cerr) {
+        vector<epoll_event> events(256);
+        auto lastReport = chrono::steady_clock::now();
+        long long lastOps = 0;
+        while (!stop) {
+            int n = epoll_wait(epfd, events.data(), (int)events.size(), 100);
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptClients();
+                    continue;
+                }
+                if (fd == wakeFd) {
+                    unsigned long long cnt;
+                    ssize_t r = ::read(wakeFd, &cnt, sizeof(cnt));
+                    (void)r;
+                    vector<int> fds;
+                    for (auto& kv : conns) fds.push_back(kv.first);
+                    for (int cfd : fds) {
+                        auto it = conns.find(cfd);
+                        if (it != conns.end() && !flushClient(it->second)) closeConnection(cfd);
+                    }
+                    continue;
+                }
+                auto it = conns.find(fd);
+                if (it == conns.end()) continue;
+                shared_ptr<Connection> c = it->second;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readClient(c);
+                if (!flushClient(c)) closeConnection(fd);
+            }
+            if (reportEverySec > 0) {
+                auto now = chrono::steady_clock::now();
+                double sec = chrono::duration<double>(now - lastReport).count();
+                if (sec >= reportEverySec) {
+                    long long ops = operations();
+                    report << "server: " << conns.size() << " clients, " << fixed << setprecision(0)
+                        << (ops - lastOps) / sec << " ops/sec\n";
+                    lastOps = ops;
+                    lastReport = now;
+                }
+            }
         }
+        pool.shutdown();
     }
 
-    static void analyticsByAilment(const vector<Patient>& patients) {
-        if (patients.empty()) {
-            cout << "No data available.\n";
-            return;
-        }
-        AnalyticsTree tree;
-        for (const auto& p : patients) tree.insert(p.ailment);
-        tree.displayInorder();
+    // Saves every manager under the lock the request handlers use.
+    void saveAll() {
+        lock_guard<mutex> lk(managersMtx);
+        plist.saveToFile();
+        am.saveToFile();
+        em.saveToFile();
+        db.saveDoctors();
+        db.saveStaff();
     }
 };
 
+// Load generator: `clients` threads each send `requests` commands produced
+// by makeRequest(client, i), keeping up to `pipeline` requests in flight.
+// Returns the number of responses received.
+template <typename MakeRequest>
+long long runSocketLoad(const string& socketPath, int clients, int requests, int pipeline, MakeRequest makeRequest) {
+    atomic<long long> received(0);
+    vector<thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c]() {
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+            if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+                if (fd >= 0) ::close(fd);
+                return;
+            }
+            int sent = 0, got = 0;
+            string pending;
+            char buf[65536];
+            while (got < requests) {
+                string out;
+                while (sent < requests && sent - got < pipeline) out += makeRequest(c, sent++) + '\n';
+                for (size_t off = 0; off < out.size();) {
+                    ssize_t n = ::send(fd, out.data() + off, out.size() - off, MSG_NOSIGNAL);
+                    if (n <= 0) { ::close(fd); return; }
+                    off += (size_t)n;
+                }
+                ssize_t n = ::read(fd, buf, sizeof(buf));
+                if (n <= 0) break;
+                for (ssize_t i = 0; i < n; ++i) if (buf[i] == '\n') ++got;
+            }
+            received += got;
+            ::close(fd);
+        });
+    }
+    for (auto& t : threads) t.join();
+    return received.load();
+}
+#endif // __linux__
+
 // ---------------------------- Console Menus --------------------------------
 void showMainMenu() {
     cout << "\n=== Hospital Management System ===\n";
@@ -706,10 +4709,22 @@ void showMainMenu() {
     cout << "5. Reporting & Analytics\n";
     cout << "6. Save All Data\n";
     cout << "7. Load All Data\n";
+    cout << "8. Performance Statistics\n";
+    cout << "9. Simulate a Day (load test)\n";
+    cout << "10. Storage Format (text/packed)\n";
     cout << "0. Exit\n";
 }
 
-void patientMenu(PatientList& plist) {
+// Prints why a patient operation on id failed when its shard is damaged;
+// returns false (nothing printed) for an ordinary missing/duplicate id.
+bool explainDamagedShard(ShardedPatientStore& plist, int id) {
+    string file;
+    if (!plist.damagedShardFor(id, file)) return false;
+    cout << "Patient records for this ID are unavailable: " << file << " could not be read. Repair it and reload.\n";
+    return true;
+}
+
+void patientMenu(ShardedPatientStore& plist) {
     while (true) {
         cout << "\n--- Patient Management ---\n";
         cout << "1. Add patient\n";
@@ -719,6 +4734,7 @@ void patientMenu(PatientList& plist) {
         cout << "5. Find patient by ID (binary search on sorted view)\n";
         cout << "6. Save patients to file\n";
         cout << "7. Load patients from file\n";
+        cout << "8. Import & merge patient files (dedup by ID)\n";
         cout << "0. Back\n";
         int ch = getInt("Choice: ");
         if (ch == 0) break;
@@ -733,18 +4749,20 @@ void patientMenu(PatientList& plist) {
             p.phone = getLine("Phone: ");
             p.assignedDoctor = getLine("Assigned doctor: ");
             if (plist.addPatient(p)) cout << "Patient added.\n";
-            else cout << "Patient with that ID already exists.\n";
+            else if (!explainDamagedShard(plist, p.id)) cout << "Patient with that ID already exists.\n";
         }
         else if (ch == 2) {
             int id = getInt("ID to remove: ");
             if (plist.removeById(id)) cout << "Removed.\n";
-            else cout << "Not found.\n";
+            else if (!explainDamagedShard(plist, id)) cout << "Not found.\n";
         }
         else if (ch == 3) {
             int id = getInt("ID to update: ");
-            PatientNode* node = plist.findById(id);
-            if (!node) { cout << "Patient not found.\n"; continue; }
-            Patient& p = node->data;
+            Patient p;      // edit a copy, then publish it as a new version
+            if (!plist.getById(id, p)) {
+                if (!explainDamagedShard(plist, id)) cout << "Patient not found.\n";
+                continue;
+            }
             cout << "Leave blank to keep existing (press Enter without typing).\n";
             cout << "Current name: " << p.name << '\n';
             string s = getLine("New name: ");
@@ -767,7 +4785,8 @@ void patientMenu(PatientList& plist) {
             cout << "Current assigned doctor: " << p.assignedDoctor << '\n';
             s = getLine("New assigned doctor: ");
             if (!s.empty()) p.assignedDoctor = s;
-            cout << "Updated.\n";
+            if (plist.updatePatient(p)) cout << "Updated.\n";
+            else if (!explainDamagedShard(plist, p.id)) cout << "Patient was removed meanwhile.\n";
         }
         else if (ch == 4) {
             plist.displayAll();
@@ -786,16 +4805,32 @@ void patientMenu(PatientList& plist) {
             }
         }
         else if (ch == 6) {
-            if (plist.saveToFile()) cout << "Saved patients.txt\n"; else cout << "Save failed.\n";
+            if (plist.saveToFile()) cout << "Saved patient shards (patients.manifest)\n"; else cout << "Save failed.\n";
         }
         else if (ch == 7) {
-            if (plist.loadFromFile()) cout << "Loaded patients.txt\n"; else cout << "Load failed or file not found.\n";
+            if (plist.loadFromFile()) cout << "Loaded patients.manifest (" << plist.shardCount() << " shards)\n"; else cout << "Load failed or file not found.\n";
+        }
+        else if (ch == 8) {
+            int n = getInt("Number of files to import: ");
+            vector<string> files;
+            for (int i = 0; i < n; ++i) files.push_back(getLine("File " + to_string(i + 1) + " (oldest first): "));
+            int pol = getInt("On duplicate ID: 1 newest wins, 2 keep first, 3 keep first & report: ");
+            ImportPolicy policy = pol == 1 ? ImportPolicy::NewestWins
+                : pol == 3 ? ImportPolicy::ReportConflicts : ImportPolicy::KeepFirst;
+            ImportResult r = importPatientFiles(plist, files, policy, (size_t)64 * 1024 * 1024);
+            if (!r.ok()) {
+                cout << "Import failed (" << r.error << "); patients unchanged.\n";
+                continue;
+            }
+            cout << "Rows read: " << r.rowsRead << " | Patients now: " << r.imported
+                << " | Duplicate IDs resolved: " << r.conflicts << '\n';
+            if (policy == ImportPolicy::ReportConflicts && r.conflicts > 0) cout << "Conflicts written to import_conflicts.txt\n";
         }
         else cout << "Invalid option.\n";
     }
 }
 
-void appointmentMenu(AppointmentManager& am, PatientList& plist) {
+void appointmentMenu(AppointmentManager& am, ShardedPatientStore& plist) {
     while (true) {
         cout << "\n--- Appointments (Routine) ---\n";
         cout << "1. Schedule routine appointment\n";
@@ -807,7 +4842,10 @@ void appointmentMenu(AppointmentManager& am, PatientList& plist) {
         if (ch == 0) break;
         if (ch == 1) {
             int pid = getInt("Patient ID: ");
-            if (!plist.findById(pid)) { cout << "Patient not found.\n"; continue; }
+            if (!plist.contains(pid)) {
+                if (!explainDamagedShard(plist, pid)) cout << "Patient not found.\n";
+                continue;
+            }
             string ts = getLine("Time slot (e.g. 2025-12-15 10:30): ");
             string notes = getLine("Notes: ");
             am.scheduleRoutine(Appointment(pid, ts, notes));
@@ -828,7 +4866,7 @@ void appointmentMenu(AppointmentManager& am, PatientList& plist) {
     }
 }
 
-void emergencyMenu(EmergencyManager& em, PatientList& plist) {
+void emergencyMenu(EmergencyManager& em, ShardedPatientStore& plist, DispatchEngine& dispatcher) {
     while (true) {
         cout << "\n--- Emergency Management ---\n";
         cout << "1. Schedule emergency\n";
@@ -836,13 +4874,19 @@ void emergencyMenu(EmergencyManager& em, PatientList& plist) {
         cout << "3. Check if patient is in emergency queue (linear search)\n";
         cout << "4. Save emergencies to file\n";
         cout << "5. Load emergencies from file\n";
+        cout << "6. Dispatch emergencies to free doctors\n";
+        cout << "7. Mark doctor as free again\n";
+        cout << "8. Set priority aging (points per minute waited)\n";
+        cout << "9. Map ailment to required specialty\n";
         cout << "0. Back\n";
         int ch = getInt("Choice: ");
         if (ch == 0) break;
         if (ch == 1) {
             int pid = getInt("Patient ID: ");
-            PatientNode* node = plist.findById(pid);
-            if (!node) { cout << "Patient not found.\n"; continue; }
+            if (!plist.contains(pid)) {
+                if (!explainDamagedShard(plist, pid)) cout << "Patient not found.\n";
+                continue;
+            }
             int pr = getInt("Priority (higher = more urgent): ");
             string notes = getLine("Notes: ");
             em.scheduleEmergency(EmergencyItem(pid, pr, notes));
@@ -859,11 +4903,44 @@ void emergencyMenu(EmergencyManager& em, PatientList& plist) {
             cout << (found ? "Patient found in emergency queue.\n" : "Patient not in emergency queue.\n");
         }
         else if (ch == 4) {
-            if (em.saveToFile()) cout << "Saved emergencies.txt\n"; else cout << "Save failed.\n";
+            if (em.saveToFile()) cout << "Saved emergencies.txt\n";
+            else if (em.damaged()) cout << "Save refused: " << em.damagedPath() << " has damaged blocks and is kept as it was.\n";
+            else cout << "Save failed.\n";
         }
         else if (ch == 5) {
             if (em.loadFromFile()) cout << "Loaded emergencies.txt\n"; else cout << "Load failed or file not found.\n";
         }
+        else if (ch == 6) {
+            vector<DispatchDecision> d = dispatcher.dispatch(nowMillis());
+            if (d.empty()) cout << "Nothing dispatched (queue empty or no suitable free doctor).\n";
+            for (const auto& x : d) {
+                cout << "Patient ID " << x.patientId << " (priority " << x.priority << ", waited "
+                    << x.waitedMs / 1000 << "s) -> " << x.doctor << '\n';
+            }
+            cout << "Still waiting: " << em.size() << " | Doctors busy: " << dispatcher.busyCount() << '\n';
+        }
+        else if (ch == 7) {
+            auto busy = dispatcher.busyDoctors();
+            for (const auto& kv : busy) cout << "  " << kv.first << " (patient " << kv.second << ")\n";
+            string name = getLine("Doctor name: ");
+            if (dispatcher.release(name)) cout << "Doctor is free.\n"; else cout << "Doctor was not busy.\n";
+        }
+        else if (ch == 8) {
+            cout << "Current aging: " << em.aging() << " per minute\n";
+            double a = getDouble("New aging (0 = strict priority): ");
+            if (a < 0) {
+                cout << "Aging cannot be negative.\n";
+                continue;
+            }
+            em.setAging(a);
+            cout << "Aging set.\n";
+        }
+        else if (ch == 9) {
+            string ailment = getLine("Ailment: ");
+            string spec = getLine("Specialty (blank = any doctor): ");
+            dispatcher.setAilmentSpecialty(ailment, spec);
+            cout << "Mapping saved for this session.\n";
+        }
         else cout << "Invalid option.\n";
     }
 }
@@ -881,6 +4958,7 @@ void doctorMenu(DoctorDB& db) {
         cout << "8. List staff\n";
         cout << "9. Save doctors & staff to file\n";
         cout << "10. Load doctors & staff from file\n";
+        cout << "11. Set doctor specialty\n";
         cout << "0. Back\n";
         int ch = getInt("Choice: ");
         if (ch == 0) break;
@@ -907,7 +4985,8 @@ void doctorMenu(DoctorDB& db) {
             auto all = db.listAllDoctors();
             if (all.empty()) cout << "No doctors.\n";
             for (const auto& kv : all) {
-                cout << "Doctor: " << kv.first << " -> ";
+                string spec = db.specialtyOf(kv.first);
+                cout << "Doctor: " << kv.first << (spec.empty() ? "" : " [" + spec + "]") << " -> ";
                 for (size_t i = 0; i < kv.second.size(); ++i) {
                     cout << kv.second[i];
                     if (i + 1 < kv.second.size()) cout << ", ";
@@ -940,38 +5019,138 @@ void doctorMenu(DoctorDB& db) {
             bool ok2 = db.loadStaff();
             cout << "Doctors loaded: " << (ok1 ? "OK" : "FAIL") << " | Staff loaded: " << (ok2 ? "OK" : "FAIL") << '\n';
         }
+        else if (ch == 11) {
+            string name = getLine("Doctor name: ");
+            string spec = getLine("Specialty (blank = general): ");
+            if (db.setSpecialty(name, spec)) cout << "Specialty set.\n"; else cout << "Doctor not found.\n";
+        }
         else cout << "Invalid option.\n";
     }
 }
 
-void reportingMenu(PatientList& plist) {
+void reportingMenu(ShardedPatientStore& plist, const AppointmentManager& am, const EmergencyManager& em) {
+    AilmentTrends* trends = plist.trendSink();
     while (true) {
         cout << "\n--- Reporting & Analytics ---\n";
         cout << "1. Generate patient report (merge sort)\n";
         cout << "2. Analytics by ailment (BST counts)\n";
+        cout << "3. Streaming patient report from disk (bounded memory)\n";
+        cout << "4. Trending ailments (last hour)\n";
+        cout << "5. Queue throughput and wait times\n";
+        cout << "0. Back\n";
+        int ch = getInt("Choice: ");
+        if (ch == 0) break;
+        if (ch == 1) {
+            ReportGenerator::patientReport(plist.snapshot());
+        }
+        else if (ch == 2) {
+            ReportGenerator::analyticsByAilment(plist.snapshot());
+        }
+        else if (ch == 3) {
+            int capKb = getInt("Memory cap in KB (0 = 64 MB): ");
+            size_t cap = capKb > 0 ? (size_t)capKb * 1024 : (size_t)64 * 1024 * 1024;
+            // changed shards are written first so the files are current
+            if (!plist.saveToFile()) { cout << "Could not save shards; report aborted.\n"; continue; }
+            ReportGenerator::streamingPatientReport(plist.shardFiles(), cap);
+        }
+        else if (ch == 4) {
+            if (!trends) { cout << "Trends are not recorded.\n"; continue; }
+            trends->print(cout, nowMillis(), 60 * 60000, 5);
+        }
+        else if (ch == 5) {
+            long long now = nowMillis();
+            ReportGenerator::queueReport("Emergencies", em.history(), now);
+            ReportGenerator::queueReport("Routine appointments", am.history(), now);
+        }
+        else cout << "Invalid option.\n";
+    }
+}
+
+void statsMenu(ShardedPatientStore& plist) {
+    while (true) {
+        cout << "\n--- Performance Statistics ---\n";
+        cout << "Patient store backend: " << PatientBackend::describe() << '\n';
+        cout << "1. Show latency per operation\n";
+        cout << "2. Dump statistics as JSON (stats.json)\n";
+        cout << "3. Reset statistics\n";
+        cout << "4. Show patient store memory\n";
+        cout << "5. Set patient memory budget\n";
         cout << "0. Back\n";
         int ch = getInt("Choice: ");
         if (ch == 0) break;
         if (ch == 1) {
-            vector<Patient> v = plist.toVector();
-            ReportGenerator::patientReport(v);
+            StatsRegistry::instance().printTable(cout);
         }
         else if (ch == 2) {
-            vector<Patient> v = plist.toVector();
-            ReportGenerator::analyticsByAilment(v);
+            ofstream fout("stats.json");
+            if (!fout.is_open()) { cout << "Could not write stats.json\n"; continue; }
+            StatsRegistry::instance().writeJson(fout);
+            fout.close();
+            cout << "Saved stats.json\n";
+        }
+        else if (ch == 3) {
+            StatsRegistry::instance().resetAll();
+            cout << "Statistics reset.\n";
+        }
+        else if (ch == 4) {
+            plist.printMemory(cout);
+        }
+        else if (ch == 5) {
+            int mb = getInt("Budget in MB (0 = no limit): ");
+            plist.setMemoryBudget((size_t)max(0, mb) * 1024 * 1024);
+            cout << "Budget set; cold saved shards are unloaded beyond it.\n";
         }
         else cout << "Invalid option.\n";
     }
 }
 
+// Replays a synthetic day against copies of the current roster and dispatch
+// policy; live queues and files are not touched.
+void simulationMenu(const DoctorDB& db, const DispatchEngine& dispatcher, const EmergencyManager& em) {
+    SimConfig cfg;
+    cfg.agingPerMinute = em.aging();
+    cout << "\n--- Simulate a Day ---\n";
+    cout << "Doctors on roster: " << db.doctorCount() << (db.doctorCount() == 0 ? " (a synthetic roster will be used)" : "") << '\n';
+    cfg.hours = max(1, getInt("Hours to simulate (e.g. 24): "));
+    cfg.routinePerHour = max(0, getInt("Routine arrivals per hour: "));
+    cfg.emergencyPerHour = max(0, getInt("Emergency arrivals per hour: "));
+    cfg.routineServiceMin = max(1, getInt("Mean routine visit (minutes): "));
+    cfg.emergencyServiceMin = max(1, getInt("Mean emergency treatment (minutes): "));
+    if (db.doctorCount() == 0) cfg.doctors = max(1, getInt("Synthetic doctors: "));
+    ostringstream current;
+    current << cfg.agingPerMinute;
+    cfg.agingPerMinute = max(0.0, getDouble("Priority aging per minute (current " + current.str() + "): "));
+    cfg.seed = (unsigned long long)getInt("Random seed: ");
+    HospitalSimulator sim(cfg, db, dispatcher.ailmentSpecialties());
+    SimResult r;
+    sim.run(r);
+    r.print(cout, cfg.hours);
+}
+
 // ---------------------------- Main ----------------------------------------
-int main() {
-    cout << "=== Hospital Management System (Full) ===\n";
+// Define HOSPITAL_NO_MAIN to reuse this file from another program (the
+// benchmark suite includes it that way).
+#ifndef HOSPITAL_NO_MAIN
+static atomic<bool> stopRequested(false);
+extern "C" void onStopSignal(int) { stopRequested = true; }
+
+// Usage: hospital_system                          interactive menus
+//        hospital_system --batch [file]           headless commands from file or stdin
+//        hospital_system --serve socket [workers] serve the batch protocol (Linux)
+int main(int argc, char** argv) {
+    bool batch = argc > 1 && string(argv[1]) == "--batch";
+    bool serve = argc > 2 && string(argv[1]) == "--serve";
+    if (argc > 1 && !batch && !serve) {
+        cout << "Usage: " << argv[0] << " [--batch [commandFile] | --serve socketPath [workers]]\n";
+        return 1;
+    }
+    if (!batch && !serve) cout << "=== Hospital Management System (Full) ===\n";
 
-    PatientList plist;
+    ShardedPatientStore plist;
     AppointmentManager apptMgr;
     EmergencyManager emergMgr;
     DoctorDB docDB;
+    DispatchEngine dispatcher(emergMgr, docDB, plist);
 
     // Auto-load existing files (non-fatal)
     plist.loadFromFile();
@@ -979,6 +5158,60 @@ int main() {
     emergMgr.loadFromFile();
     docDB.loadDoctors();
     docDB.loadStaff();
+    if (emergMgr.damaged())
+        cerr << "Warning: " << emergMgr.damagedPath() << " has damaged blocks; " << emergMgr.size()
+             << " emergencies recovered, the file is kept and will not be overwritten.\n";
+
+    // attached after the loads: only new arrivals count towards trends
+    AilmentTrends trends;
+    plist.attachTrends(&trends);
+    emergMgr.attachTrends(&trends, &plist);
+
+    if (batch) {
+        // no prompts, no stdio sync, no flush per line
+        ios::sync_with_stdio(false);
+        cin.tie(nullptr);
+        ifstream fin;
+        if (argc > 2) {
+            fin.open(argv[2]);
+            if (!fin.is_open()) {
+                cerr << "Cannot open " << argv[2] << '\n';
+                return 1;
+            }
+        }
+        BatchProcessor bp(plist, apptMgr, emergMgr, docDB, cout);
+        bp.run(argc > 2 ? (istream&)fin : cin);
+        // like exiting the menus, a batch run ends by saving everything
+        bool saved = plist.saveToFile() & apptMgr.saveToFile() & emergMgr.saveToFile()
+            & docDB.saveDoctors() & docDB.saveStaff();
+        cout << "done|" << bp.succeeded() << '|' << bp.failed() << '|' << (saved ? "saved" : "save-failed") << '\n';
+        cout.flush();
+        return bp.failed() == 0 && saved ? 0 : 2;
+    }
+
+    if (serve) {
+#ifdef __linux__
+        int workers = argc > 3 ? max(1, atoi(argv[3])) : max(1, (int)thread::hardware_concurrency());
+        SocketServer server(argv[2], plist, apptMgr, emergMgr, docDB, workers);
+        if (!server.start()) {
+            cerr << "Cannot listen on " << argv[2] << '\n';
+            return 1;
+        }
+        signal(SIGINT, onStopSignal);
+        signal(SIGTERM, onStopSignal);
+        cout << "Serving on " << argv[2] << " with " << workers << " workers (Ctrl+C to stop)\n";
+        auto started = chrono::steady_clock::now();
+        server.run(stopRequested, 5, cout);
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        cout << "Stopping: " << server.operations() << " requests, " << fixed << setprecision(0)
+            << (sec > 0 ? server.operations() / sec : 0.0) << " ops/sec average. Saving data...\n";
+        server.saveAll();
+        return 0;
+#else
+        cerr << "--serve needs Unix domain sockets (Linux only)\n";
+        return 1;
+#endif
+    }
 
     while (true) {
         showMainMenu();
@@ -986,19 +5219,28 @@ int main() {
         if (ch == 0) {
             // Save all before exit
             cout << "Saving data...\n";
-            plist.saveToFile();
-            apptMgr.saveToFile();
-            emergMgr.saveToFile();
-            docDB.saveDoctors();
-            docDB.saveStaff();
-            cout << "Saved. Exiting.\n";
+            bool saved = plist.saveToFile() & apptMgr.saveToFile() & emergMgr.saveToFile()
+                & docDB.saveDoctors() & docDB.saveStaff();
+            cout << (saved ? "Saved. Exiting.\n" : "Some files could not be saved (damaged files are kept as they were). Exiting.\n");
             break;
         }
         if (ch == 1) patientMenu(plist);
         else if (ch == 2) appointmentMenu(apptMgr, plist);
-        else if (ch == 3) emergencyMenu(emergMgr, plist);
+        else if (ch == 3) emergencyMenu(emergMgr, plist, dispatcher);
         else if (ch == 4) doctorMenu(docDB);
-        else if (ch == 5) reportingMenu(plist);
+        else if (ch == 5) reportingMenu(plist, apptMgr, emergMgr);
+        else if (ch == 8) statsMenu(plist);
+        else if (ch == 9) simulationMenu(docDB, dispatcher, emergMgr);
+        else if (ch == 10) {
+            cout << "Patients and emergencies are saved as " << formatName(plist.format())
+                << " (either format is read on load).\n";
+            int f = getInt("1 = text, 2 = packed binary: ");
+            if (f != 1 && f != 2) { cout << "Unchanged.\n"; continue; }
+            StorageFormat fmt = f == 2 ? StorageFormat::Packed : StorageFormat::Text;
+            plist.setFormat(fmt);
+            emergMgr.setFormat(fmt);
+            cout << "Format set to " << formatName(fmt) << "; takes effect on the next save.\n";
+        }
         else if (ch == 6) {
             bool ok1 = plist.saveToFile();
             bool ok2 = apptMgr.saveToFile();
@@ -1027,4 +5269,5 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif // HOSPITAL_NO_MAIN
\ No newline at end of file
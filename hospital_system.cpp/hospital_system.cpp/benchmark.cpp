@@ -0,0 +1,620 @@
+// benchmark.cpp
+// Benchmark suite for the Hospital Management System
+// - Deterministic synthetic hospital (patients, appointments, emergencies,
+//   doctors, staff) at a configurable scale
+// - Microbenchmarks for each manager's hot operations: load/save, lookup,
+//   sort, heap push/pop, reports, import, emergency dispatch
+// - Text vs. packed storage format: save, streaming scan, bytes on disk
+// - PatientStore backends (storage/index/allocator policies) side by side
+// - Discrete-event simulation of a loaded day, strict priority vs. aging
+// - Socket server throughput under concurrent pipelined clients (Linux)
+// - One result line per benchmark, optionally written as JSON for comparing runs
+//
+// Build: cmake -S . -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build
+// Run:   ./build/hospital_bench [--scale N] [--seed S] [--dir DIR] [--json FILE] [--stats]
+
+#define HOSPITAL_NO_MAIN
+#include "FileName.cpp"
+
+#include <filesystem>
+#include <random>
+#include <unordered_set>
+
+// ---------------------------- Synthetic Data Generator ---------------------
+struct SyntheticHospital {
+    vector<Patient> patients;
+    vector<Appointment> appointments;
+    vector<EmergencyItem> emergencies;
+    vector<pair<string, vector<string>>> doctors;
+    vector<pair<string, string>> staff;
+};
+
+// Same scale and seed always give the same hospital.
+SyntheticHospital generateHospital(int scale, unsigned long long seed) {
+    static const char* ailments[] = { "Flu", "Cold", "Fracture", "Migraine", "Asthma", "Diabetes",
+        "Hypertension", "Allergy", "Burn", "Infection", "Sprain", "Covid", "Bronchitis", "Anemia" };
+    static const char* roles[] = { "nurse", "technician", "pharmacist", "receptionist", "cleaner" };
+    const int numAilments = (int)(sizeof(ailments) / sizeof(ailments[0]));
+    mt19937_64 rng(seed);
+    SyntheticHospital h;
+
+    int numDoctors = max(5, scale / 100);
+    for (int d = 0; d < numDoctors; ++d) {
+        vector<string> slots;
+        for (int k = 0; k < 8; ++k) {
+            ostringstream ts;
+            ts << "2025-12-" << setw(2) << setfill('0') << (1 + (int)(rng() % 28)) << ' '
+                << setw(2) << (8 + (int)(rng() % 10)) << ":00";
+            slots.push_back(ts.str());
+        }
+        h.doctors.push_back({ "Dr " + to_string(d), slots });
+    }
+    for (int i = 0; i < max(1, scale / 50); ++i)
+        h.staff.push_back({ "Staff " + to_string(i), roles[rng() % 5] });
+
+    // ids are unique and spread over [1, 10 * scale], in shuffled order
+    h.patients.reserve(scale);
+    for (int i = 0; i < scale; ++i) {
+        Patient p;
+        p.id = i * 10 + 1 + (int)(rng() % 10);
+        p.name = "Patient " + to_string(p.id);
+        p.age = (int)(rng() % 96);
+        p.gender = (rng() % 2) ? "M" : "F";
+        // skewed ailment mix: low indexes are far more common
+        int a = (int)((rng() % numAilments) * (rng() % numAilments) / numAilments);
+        p.ailment = ailments[a];
+        p.priority = (int)(rng() % 11);
+        p.phone = to_string(5550000000ULL + rng() % 10000000ULL);
+        p.assignedDoctor = h.doctors[rng() % h.doctors.size()].first;
+        h.patients.push_back(p);
+    }
+    shuffle(h.patients.begin(), h.patients.end(), rng);
+
+    for (int i = 0; i < scale / 2; ++i) {
+        const Patient& p = h.patients[rng() % h.patients.size()];
+        const auto& doc = h.doctors[rng() % h.doctors.size()];
+        h.appointments.push_back(Appointment(p.id, doc.second[rng() % doc.second.size()], "checkup"));
+        h.emergencies.push_back(EmergencyItem(p.id, (int)(rng() % 100), p.ailment));
+    }
+    return h;
+}
+
+// ---------------------------- Benchmark Runner -----------------------------
+struct BenchResult {
+    string name;
+    long long ops;
+    double seconds;
+};
+
+class BenchRunner {
+private:
+    vector<BenchResult> results;
+public:
+    BenchRunner() {
+        cout << left << setw(34) << "Benchmark" << right << setw(12) << "Ops" << setw(14) << "Total(ms)"
+            << setw(14) << "ns/op" << setw(16) << "ops/sec" << '\n';
+        cout << string(90, '-') << '\n';
+    }
+
+    // Times fn() once; ops is the number of operations it performs.
+    template <typename Fn>
+    void run(const string& name, long long ops, Fn fn) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        add(name, ops, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+
+    // Records a result timed elsewhere (e.g. when ops is only known afterwards).
+    void add(const string& name, long long ops, double sec) {
+        results.push_back({ name, ops, sec });
+        cout << left << setw(34) << name << right << setw(12) << ops << fixed << setprecision(2)
+            << setw(14) << sec * 1e3 << setw(14) << (ops ? sec * 1e9 / ops : 0.0)
+            << setw(16) << (sec > 0 ? ops / sec : 0.0) << '\n' << left;
+    }
+
+    bool writeJson(const string& filename, int scale, unsigned long long seed) const {
+        ofstream fout(filename);
+        if (!fout.is_open()) return false;
+        fout << "{\"scale\":" << scale << ",\"seed\":" << seed << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            if (i) fout << ',';
+            fout << "{\"name\":\"" << r.name << "\",\"ops\":" << r.ops << fixed << setprecision(1)
+                << ",\"total_ms\":" << r.seconds * 1e3
+                << ",\"ns_per_op\":" << (r.ops ? r.seconds * 1e9 / r.ops : 0.0)
+                << ",\"ops_per_sec\":" << (r.seconds > 0 ? r.ops / r.seconds : 0.0) << '}';
+        }
+        fout << "]}\n";
+        fout.close();
+        return true;
+    }
+};
+
+// Swallows report output while it is being timed.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+class SilenceCout {
+private:
+    NullBuffer nullBuf;
+    streambuf* saved;
+public:
+    SilenceCout() : saved(cout.rdbuf(&nullBuf)) {}
+    ~SilenceCout() { cout.rdbuf(saved); }
+};
+
+// ---------------------------- Benchmarks -----------------------------------
+void benchPatients(BenchRunner& br, const SyntheticHospital& h, mt19937_64& rng) {
+    const int n = (int)h.patients.size();
+    unordered_set<int> ids;
+    for (const auto& p : h.patients) ids.insert(p.id);
+    vector<int> hits, misses;
+    for (int i = 0; i < n; ++i) {
+        hits.push_back(h.patients[rng() % n].id);
+        int m;
+        do m = 1 + (int)(rng() % (10ULL * n)); while (ids.count(m));
+        misses.push_back(m);
+    }
+
+    {
+        ShardedPatientStore store("bench_patients.manifest");
+        br.run("patients.addPatient", n, [&]() {
+            for (const auto& p : h.patients) store.addPatient(p);
+        });
+        volatile long long found = 0;
+        br.run("patients.findById.hit", n, [&]() {
+            for (int id : hits) found += store.contains(id);
+        });
+        br.run("patients.findById.miss", n, [&]() {
+            for (int id : misses) found += store.contains(id);
+        });
+        br.run("patients.snapshot", 1000, [&]() {
+            for (int i = 0; i < 1000; ++i) found += store.snapshot().size();
+        });
+        br.run("patients.saveToFile", n, [&]() { store.saveToFile(); });
+    }
+    {
+        ShardedPatientStore store("bench_patients.manifest");
+        br.run("patients.loadFromFile+loadAll", n, [&]() {
+            store.loadFromFile();
+            store.loadAll();
+        });
+    }
+    {
+        ShardedPatientStore cold("bench_patients.manifest");
+        cold.loadFromFile();
+        volatile long long found = 0;
+        br.run("patients.findById.coldMiss", n, [&]() {
+            for (int id : misses) found += cold.contains(id);
+        });
+    }
+}
+
+void benchSortSearch(BenchRunner& br, const SyntheticHospital& h, mt19937_64& rng) {
+    const int n = (int)h.patients.size();
+    vector<Patient> a = h.patients;
+    br.run("sort.quickSort", n, [&]() { quickSort(a, 0, n - 1); });
+    vector<Patient> b = h.patients;
+    br.run("sort.mergeSort", n, [&]() { mergeSort(b, 0, n - 1); });
+    volatile long long found = 0;
+    br.run("search.binarySearchById", n, [&]() {
+        for (int i = 0; i < n; ++i) found += binarySearchById(a, h.patients[rng() % n].id) >= 0;
+    });
+}
+
+void benchQueues(BenchRunner& br, const SyntheticHospital& h) {
+    const long long na = (long long)h.appointments.size();
+    const long long ne = (long long)h.emergencies.size();
+    AppointmentManager am;
+    br.run("appointments.scheduleRoutine", na, [&]() {
+        for (const auto& a : h.appointments) am.scheduleRoutine(a);
+    });
+    br.run("appointments.saveToFile", na, [&]() { am.saveToFile("bench_appointments.txt"); });
+    br.run("appointments.loadFromFile", na, [&]() { am.loadFromFile("bench_appointments.txt"); });
+    br.run("appointments.popNextRoutine", na, [&]() {
+        while (am.hasRoutine()) am.popNextRoutine();
+    });
+
+    EmergencyManager em;
+    br.run("emergencies.scheduleEmergency", ne, [&]() {
+        for (const auto& e : h.emergencies) em.scheduleEmergency(e);
+    });
+    br.run("emergencies.saveToFile", ne, [&]() { em.saveToFile("bench_emergencies.txt"); });
+    br.run("emergencies.loadFromFile", ne, [&]() { em.loadFromFile("bench_emergencies.txt"); });
+    br.run("emergencies.popNextEmergency", ne, [&]() {
+        while (em.hasEmergency()) em.popNextEmergency();
+    });
+    br.run("reports.queueReport", ne + na, [&]() {
+        SilenceCout quiet;
+        ReportGenerator::queueReport("Emergencies", em.history(), nowMillis());
+        ReportGenerator::queueReport("Routine appointments", am.history(), nowMillis());
+    });
+}
+
+// One shard's worth of patients in a given PatientStore configuration.
+template <typename Store>
+void benchBackend(BenchRunner& br, const vector<Patient>& patients, const vector<int>& hits, const vector<int>& misses) {
+    const long long n = (long long)patients.size();
+    const string tag = "backend." + Store::describe();
+    Store store;
+    br.run(tag + ".add", n, [&]() {
+        for (const auto& p : patients) store.addPatient(p);
+    });
+    volatile long long found = 0;
+    br.run(tag + ".findHit", (long long)hits.size(), [&]() {
+        for (int id : hits) found += store.findById(id) != nullptr;
+    });
+    br.run(tag + ".findMiss", (long long)misses.size(), [&]() {
+        for (int id : misses) found += store.findById(id) != nullptr;
+    });
+    br.run(tag + ".scan(x10)", 10 * n, [&]() {
+        for (int k = 0; k < 10; ++k) store.snapshot().forEach([&](const Patient& p) { found += p.age; });
+    });
+    // a write after a snapshot pays for one copy-on-write copy of the version
+    br.run(tag + ".cowUpdate", 100, [&]() {
+        for (int k = 0; k < 100; ++k) {
+            auto snap = store.snapshot();
+            store.updatePatient(patients[(size_t)k % patients.size()]);
+        }
+    });
+    br.run(tag + ".remove", n / 10, [&]() {
+        for (long long i = 0; i < n / 10; ++i) store.removeById(hits[(size_t)i]);
+    });
+}
+
+// The same workload on each storage/index/allocator combination worth
+// comparing, at the size of one shard.
+void benchBackends(BenchRunner& br, const SyntheticHospital& h, mt19937_64& rng) {
+    vector<Patient> shard(h.patients.begin(), h.patients.begin() + min<size_t>(h.patients.size(), 10000));
+    if (shard.empty()) return;
+    unordered_set<int> ids;
+    for (const auto& p : shard) ids.insert(p.id);
+    vector<int> hits, misses;
+    for (size_t i = 0; i < shard.size(); ++i) {
+        hits.push_back(shard[rng() % shard.size()].id);
+        int m;
+        do m = (int)(rng() % (10ULL * shard.size() + 10)); while (ids.count(m));
+        misses.push_back(m);
+    }
+    benchBackend<PatientStore<ListStorage, BloomIndex, StdAllocPolicy>>(br, shard, hits, misses);
+    benchBackend<PatientStore<ListStorage, HashIndex, PoolAllocPolicy>>(br, shard, hits, misses);
+    benchBackend<PatientStore<VectorStorage, HashIndex, StdAllocPolicy>>(br, shard, hits, misses);
+    benchBackend<PatientStore<HashStorage, NoIndex, StdAllocPolicy>>(br, shard, hits, misses);
+    benchBackend<PatientStore<HashStorage, NoIndex, PoolAllocPolicy>>(br, shard, hits, misses);
+    benchBackend<PatientStore<BTreeStorage, NoIndex, StdAllocPolicy>>(br, shard, hits, misses);
+    benchBackend<PatientStore<BTreeStorage, BloomIndex, PoolAllocPolicy>>(br, shard, hits, misses);
+}
+
+// Lookups under a memory budget: 80% of them hit 20% of the ids, over
+// 1000-id shards saved to disk. With a budget of a quarter of the store the
+// CLOCK hand keeps the hot shards and faults the others back in.
+void benchMemoryBudget(BenchRunner& br, const SyntheticHospital& h, mt19937_64& rng) {
+    const int n = (int)h.patients.size();
+    if (n == 0) return;
+    ShardedPatientStore store("bench_budget.manifest", 1000);
+    vector<char> added;
+    store.addBatch(h.patients, added);
+    store.saveToFile();
+    size_t full = store.memoryUsage().total();
+    vector<int> sorted;
+    for (const auto& p : h.patients) sorted.push_back(p.id);
+    sort(sorted.begin(), sorted.end());
+    const int hot = max(1, n / 5);              // the lowest ids, i.e. the first fifth of the shards
+    vector<int> ids(n);
+    for (int i = 0; i < n; ++i) ids[i] = sorted[rng() % 5 != 0 ? rng() % hot : rng() % n];
+    for (int pct : { 100, 25 }) {
+        store.setMemoryBudget(full * pct / 100);
+        unsigned long long loads = store.shardLoadCount(), evicted = store.evictionCount();
+        Patient out;
+        br.run("patients.findById(budget " + to_string(pct) + "%)", n, [&]() {
+            for (int id : ids) store.getById(id, out);
+        });
+        cout << "  resident " << store.memoryUsage().total() / 1024 << " KB of " << full / 1024 << " KB, shard loads "
+            << store.shardLoadCount() - loads << ", evictions " << store.evictionCount() - evicted << '\n';
+    }
+}
+
+// Text vs. packed files: write, streaming scan, and size on disk.
+void benchFormats(BenchRunner& br, const SyntheticHospital& h) {
+    const long long n = (long long)h.patients.size();
+    PatientBackend list;
+    list.bulkLoadUnique(h.patients);
+    PatientSnapshot snap = list.snapshot();
+    EmergencyManager em;
+    for (const auto& e : h.emergencies) em.scheduleEmergency(e);
+    for (StorageFormat fmt : { StorageFormat::Text, StorageFormat::Packed }) {
+        string tag = formatName(fmt);
+        string pf = "bench_format_patients." + tag, ef = "bench_format_emergencies." + tag;
+        br.run("format." + tag + ".patients.save", n, [&]() { snap.saveToFile(pf, fmt); });
+        volatile long long ages = 0;
+        br.run("format." + tag + ".patients.scan", n, [&]() {
+            for (PatientFileReader r(pf); r.valid(); r.advance()) ages += r.current().age;
+        });
+        br.run("format." + tag + ".emergencies.save", (long long)h.emergencies.size(), [&]() { em.saveToFile(ef, fmt); });
+        EmergencyManager back;
+        br.run("format." + tag + ".emergencies.load", (long long)h.emergencies.size(), [&]() { back.loadFromFile(ef); });
+        cout << "  " << tag << ": patients " << filesystem::file_size(pf) << " bytes, emergencies "
+            << filesystem::file_size(ef) << " bytes\n";
+    }
+}
+
+void benchDoctors(BenchRunner& br, const SyntheticHospital& h) {
+    DoctorDB db;
+    long long slots = 0;
+    for (const auto& d : h.doctors) slots += (long long)d.second.size();
+    br.run("doctors.addDoctor+availability", slots, [&]() {
+        for (const auto& d : h.doctors) {
+            db.addDoctor(d.first);
+            for (const auto& ts : d.second) db.addAvailability(d.first, ts);
+        }
+        for (const auto& s : h.staff) db.addStaff(s.first, s.second);
+    });
+    br.run("doctors.listAllDoctors", 1000, [&]() {
+        for (int i = 0; i < 1000; ++i) db.listAllDoctors();
+    });
+    br.run("doctors.save", slots, [&]() {
+        db.saveDoctors("bench_doctors.txt");
+        db.saveStaff("bench_staff.txt");
+    });
+    br.run("doctors.load", slots, [&]() {
+        db.loadDoctors("bench_doctors.txt");
+        db.loadStaff("bench_staff.txt");
+    });
+}
+
+void benchReports(BenchRunner& br, const SyntheticHospital& h) {
+    const int n = (int)h.patients.size();
+    ShardedPatientStore store("bench_patients.manifest");
+    store.loadFromFile();
+    PatientSnapshot snap = store.snapshot();
+    br.run("reports.patientReport", n, [&]() {
+        SilenceCout quiet;
+        ReportGenerator::patientReport(snap);
+    });
+    br.run("reports.analyticsByAilment", n, [&]() {
+        SilenceCout quiet;
+        ReportGenerator::analyticsByAilment(snap);
+    });
+    br.run("reports.streamingReport(1MB)", n, [&]() {
+        SilenceCout quiet;
+        ReportGenerator::streamingPatientReport(store.shardFiles(), (size_t)1024 * 1024);
+    });
+
+    // two overlapping exports, half of the ids in common
+    {
+        ofstream a("bench_export_a.txt"), b("bench_export_b.txt");
+        for (int i = 0; i < n; ++i) {
+            if (i % 2 == 0 || i % 3 == 0) a << h.patients[i].serialize() << '\n';
+            if (i % 2 == 1 || i % 3 == 0) b << h.patients[i].serialize() << '\n';
+        }
+    }
+    ShardedPatientStore target("bench_import.manifest");
+    br.run("patients.import(2 files)", n, [&]() {
+        importPatientFiles(target, { "bench_export_a.txt", "bench_export_b.txt" },
+            ImportPolicy::NewestWins, (size_t)8 * 1024 * 1024);
+    });
+}
+
+// scale/2 emergencies against the synthetic doctors, some of them
+// specialists. Cases arrive at 110% of treatment capacity, so a queue
+// builds up. Each virtual second admits the new arrivals and runs one
+// dispatch round, then every busy doctor finishes. Reports decisions/sec
+// and the virtual wait times.
+void benchDispatch(BenchRunner& br, const SyntheticHospital& h) {
+    ShardedPatientStore store("bench_dispatch.manifest");
+    vector<char> added;
+    store.addBatch(h.patients, added);
+    DoctorDB db;
+    static const char* specs[] = { "", "", "Cardiology", "Pulmonology", "Orthopedics" };
+    for (size_t i = 0; i < h.doctors.size(); ++i) {
+        db.addDoctor(h.doctors[i].first);
+        db.setSpecialty(h.doctors[i].first, specs[i % 5]);
+    }
+    EmergencyManager em;
+    em.setAging(1.0);
+    const long long base = 1000000000000LL;
+    const double gapMs = 1000.0 / (1.1 * (double)h.doctors.size());
+    DispatchEngine engine(em, db, store, 1024);
+    engine.setAilmentSpecialty("Hypertension", "Cardiology");
+    engine.setAilmentSpecialty("Asthma", "Pulmonology");
+    engine.setAilmentSpecialty("Bronchitis", "Pulmonology");
+    engine.setAilmentSpecialty("Fracture", "Orthopedics");
+    engine.setAilmentSpecialty("Sprain", "Orthopedics");
+
+    LatencyHistogram& wait = opStats("dispatch.waitTime");
+    wait.reset();
+    long long rounds = 0;
+    br.run("dispatch.decisions", (long long)h.emergencies.size(), [&]() {
+        long long now = base;
+        size_t next = 0;
+        while (next < h.emergencies.size() || em.hasEmergency()) {
+            now += 1000;
+            for (; next < h.emergencies.size(); ++next) {
+                EmergencyItem e = h.emergencies[next];
+                e.arrival = base + (long long)(next * gapMs);
+                if (e.arrival > now) break;
+                em.scheduleEmergency(e);
+            }
+            engine.dispatch(now);
+            for (const auto& b : engine.busyDoctors()) engine.release(b.first);
+            ++rounds;
+        }
+    });
+    cout << "  " << rounds << " rounds, virtual wait p50 " << wait.percentile(0.50) / 1000000 << " ms, p99 "
+        << wait.percentile(0.99) / 1000000 << " ms, max " << wait.max() / 1000000 << " ms\n";
+}
+
+// A simulated day of an emergency surge, once with strict priority and once
+// with aging, so the two triage policies can be compared side by side. The
+// emergencies alone need 225 of the 180 doctor-minutes per hour, so a queue
+// builds up and the order in which it is served shows in the waits.
+void benchSimulation(BenchRunner& br, const SyntheticHospital& h, unsigned long long seed) {
+    DoctorDB empty;
+    for (double aging : { 0.0, 2.0 }) {
+        SimConfig cfg;
+        cfg.doctors = 3;
+        cfg.hours = 24.0;
+        cfg.emergencyPerHour = 5.0;                    // 45 minutes each
+        cfg.routinePerHour = 1.0;
+        cfg.agingPerMinute = aging;
+        cfg.population = max(1, (int)h.patients.size());
+        cfg.seed = seed;
+        HospitalSimulator sim(cfg, empty, {});
+        SimResult r;
+        sim.run(r);
+        br.add(aging > 0 ? "simulation.day.aging" : "simulation.day.strict", r.events, r.wallSeconds);
+        cout << "  emergency wait p50 " << fixed << setprecision(1) << r.emergencyWait.percentile(0.50) / 60000.0
+            << " min, p99 " << r.emergencyWait.percentile(0.99) / 60000.0 << " min; urgent p50 "
+            << r.urgentWait.percentile(0.50) / 60000.0 << " min; max queue " << r.maxEmergencyQueue
+            << "; utilization " << r.utilization * 100.0 << "%\n";
+    }
+}
+
+// Every synthetic patient's ailment recorded as an arrival spread over two
+// hours of virtual time, then last-hour top-10 queries against the sketches.
+void benchTrends(BenchRunner& br, const SyntheticHospital& h) {
+    const int n = (int)h.patients.size();
+    const long long spanMs = 2 * 60 * 60000LL;
+    AilmentTrends trends;
+    br.run("trends.record", n, [&]() {
+        for (int i = 0; i < n; ++i)
+            trends.record(TrendSource::Admissions, h.patients[i].ailment, spanMs * i / max(1, n));
+    });
+    const int queries = 1000;
+    unsigned long long total = 0;
+    br.run("trends.top(60min,10)", queries, [&]() {
+        for (int q = 0; q < queries; ++q) trends.top(TrendSource::Admissions, spanMs, 60 * 60000LL, 10, total);
+    });
+}
+
+#ifdef __linux__
+// Concurrent clients pipelining a read-heavy mix against the socket server.
+void benchServer(BenchRunner& br, const SyntheticHospital& h, int clients, int pipeline) {
+    ShardedPatientStore store("bench_server.manifest");
+    vector<char> added;
+    store.addBatch(h.patients, added);
+    AppointmentManager am;
+    EmergencyManager em;
+    DoctorDB db;
+    SocketServer server("bench.sock", store, am, em, db, max(2, (int)thread::hardware_concurrency()));
+    if (!server.start()) {
+        cout << "server.socket: could not listen on bench.sock\n";
+        return;
+    }
+    atomic<bool> stop(false);
+    thread loop([&]() { server.run(stop); });
+
+    const int n = (int)h.patients.size();
+    const int perClient = max(1, n / clients);
+    auto request = [&](int c, int i) -> string {
+        const Patient& p = h.patients[((long long)c * perClient + i) % n];
+        switch (i % 8) {
+        case 0: return "emergency|" + to_string(p.id) + "|" + to_string(p.priority) + "|bench";
+        case 1: return "schedule|" + to_string(p.id) + "|2025-12-01 09:00|bench";
+        default: return "find|" + to_string(p.id);
+        }
+    };
+    long long got = 0;
+    br.run("server.socket(" + to_string(clients) + "x" + to_string(pipeline) + ")", (long long)clients * perClient, [&]() {
+        got = runSocketLoad("bench.sock", clients, perClient, pipeline, request);
+    });
+    stop = true;
+    loop.join();
+    if (got != (long long)clients * perClient)
+        cout << "  (only " << got << " of " << (long long)clients * perClient << " responses received)\n";
+}
+#endif
+
+// ---------------------------- Main -----------------------------------------
+// The working directory must be new, empty, or one this benchmark made
+// before (it holds the marker file). Only files named bench* are removed,
+// so pointing --dir at real data refuses to run instead of wiping it.
+static const char* BENCH_MARKER = ".hospital_bench";
+
+bool prepareBenchDir(const string& dir) {
+    error_code ec;
+    if (!filesystem::exists(dir)) {
+        filesystem::create_directories(dir, ec);
+        if (ec) {
+            cerr << "Cannot create " << dir << ": " << ec.message() << '\n';
+            return false;
+        }
+    }
+    else if (!filesystem::is_directory(dir)) {
+        cerr << dir << " is not a directory\n";
+        return false;
+    }
+    else if (!filesystem::is_empty(dir) && !filesystem::exists(filesystem::path(dir) / BENCH_MARKER)) {
+        cerr << dir << " is not empty and was not created by hospital_bench; choose another --dir\n";
+        return false;
+    }
+    for (const auto& entry : filesystem::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().filename().string().rfind("bench", 0) == 0)
+            filesystem::remove(entry.path(), ec);
+    }
+    ofstream marker(filesystem::path(dir) / BENCH_MARKER);
+    if (!marker) {
+        cerr << "Cannot write to " << dir << '\n';
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int scale = 50000;
+    unsigned long long seed = 42;
+    string dir = "bench_data";
+    string jsonFile;
+    bool showStats = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) scale = max(1, atoi(argv[++i]));
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dir" && i + 1 < argc) dir = argv[++i];
+        else if (arg == "--json" && i + 1 < argc) jsonFile = argv[++i];
+        else if (arg == "--stats") showStats = true;
+        else {
+            cout << "Usage: hospital_bench [--scale N] [--seed S] [--dir DIR] [--json FILE] [--stats]\n";
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (!jsonFile.empty()) jsonFile = filesystem::absolute(jsonFile).string();
+
+    // all benchmark files live in their own directory, away from real data
+    if (!prepareBenchDir(dir)) return 1;
+    filesystem::current_path(dir);
+
+    cout << "Hospital benchmarks: scale " << scale << ", seed " << seed << ", "
+        << thread::hardware_concurrency() << " hardware threads\n\n";
+    SyntheticHospital h = generateHospital(scale, seed);
+    mt19937_64 rng(seed ^ 0x5EEDULL);
+
+    BenchRunner br;
+    benchPatients(br, h, rng);
+    benchBackends(br, h, rng);
+    benchSortSearch(br, h, rng);
+    benchQueues(br, h);
+    benchFormats(br, h);
+    benchMemoryBudget(br, h, rng);
+    benchDoctors(br, h);
+    benchReports(br, h);
+    benchDispatch(br, h);
+    benchSimulation(br, h, seed);
+    benchTrends(br, h);
+#ifdef __linux__
+    benchServer(br, h, 1, 1);
+    benchServer(br, h, 8, 64);
+#endif
+
+    if (showStats) {
+        cout << "\nBuilt-in latency statistics:\n";
+        StatsRegistry::instance().printTable(cout);
+    }
+    if (!jsonFile.empty()) {
+        if (br.writeJson(jsonFile, scale, seed)) cout << "\nResults written to " << jsonFile << '\n';
+        else cout << "\nCould not write " << jsonFile << '\n';
+    }
+    return 0;
+}
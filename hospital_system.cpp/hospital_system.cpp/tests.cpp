@@ -0,0 +1,335 @@
+// tests.cpp
+// Regression tests for the Hospital Management System
+// - Patient snapshots stay isolated from later writes and evictions
+// - External sort: merges of more runs than MERGE_FAN_IN, unreadable runs
+// - Patient import under each policy, and refused over a damaged shard
+// - Damaged packed files: good blocks are kept and the file is not overwritten
+// - Every test runs in its own empty directory, so data files never mix
+//
+// Build: cmake -S . -B build && cmake --build build
+// Run:   ctest --test-dir build --output-on-failure   (or ./build/hospital_tests [name])
+
+#define HOSPITAL_NO_MAIN
+#include "FileName.cpp"
+
+#include <filesystem>
+
+// ---------------------------- Test Harness ---------------------------------
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            ++checkFailures;                                                         \
+            cerr << "  " << __FILE__ << ':' << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+        }                                                                            \
+    } while (0)
+
+Patient makePatient(int id, const string& name = "P") {
+    Patient p;
+    p.id = id;
+    p.name = name + to_string(id);
+    p.age = 20 + id % 60;
+    p.gender = id % 2 ? "M" : "F";
+    p.ailment = "flu";
+    p.priority = id % 10;
+    p.phone = "555";
+    p.assignedDoctor = "None";
+    return p;
+}
+
+// ---------------------------- Snapshots ------------------------------------
+// A snapshot keeps the records it was taken with across updates, removals,
+// additions and the eviction of the shards it came from.
+void testSnapshotIsolation() {
+    ShardedPatientStore store;
+    for (int id = 1; id <= 30000; id += 1000) store.addPatient(makePatient(id, "before"));
+    CHECK(store.shardCount() == 3);
+    PatientSnapshot snap = store.snapshot();
+
+    CHECK(store.updatePatient(makePatient(1, "after")));
+    CHECK(store.removeById(10001));
+    CHECK(store.addPatient(makePatient(20002)));
+    CHECK(store.saveToFile());
+    store.setMemoryBudget(1);                   // every shard is saved, so all go
+    CHECK(store.loadedShardCount() == 0);
+
+    CHECK(snap.size() == 30);
+    const Patient* p = snap.findById(1);
+    CHECK(p && p->name == "before1");
+    CHECK(snap.findById(10001) != nullptr);
+    CHECK(snap.findById(20002) == nullptr);
+    int seen = 0;
+    snap.forEach([&](const Patient& q) { seen += q.name.compare(0, 6, "before") == 0; });
+    CHECK(seen == 30);
+
+    Patient cur;
+    CHECK(store.getById(1, cur) && cur.name == "after1");
+    CHECK(!store.contains(10001));
+    CHECK(store.contains(20002));
+    CHECK(store.snapshot().size() == 30);
+}
+
+// ---------------------------- External Sort --------------------------------
+// Every id twice, the "a" copy earlier in the file, in shuffled id order.
+void writeShuffledPatients(const string& file, int n, unsigned long long seed) {
+    vector<int> ids(n);
+    for (int i = 0; i < n; ++i) ids[i] = i + 1;
+    shuffle(ids.begin(), ids.end(), mt19937_64(seed));
+    ofstream fout(file);
+    for (int id : ids) fout << makePatient(id, "a").serialize() << '\n';
+    for (int id : ids) fout << makePatient(id, "b").serialize() << '\n';
+}
+
+// Far more runs than one heap may hold: merged in passes, sorted, complete,
+// and equal ids still in input order.
+void testMergeBeyondFanIn() {
+    writeShuffledPatients("input.txt", 2000, 7);
+    TempFileSet temps;
+    long long read = 0;
+    CHECK(writeSortedRuns({ "input.txt" }, 2000, "run_", temps, [&](const Patient&) { ++read; }));
+    CHECK(read == 4000);
+    CHECK(temps.files.size() > 2 * MERGE_FAN_IN);
+
+    vector<string> runs = temps.files;
+    CHECK(mergeRunsBounded(runs, MERGE_FAN_IN, "merge_", temps));
+    CHECK(!runs.empty() && runs.size() <= MERGE_FAN_IN);
+
+    PatientMergeStream merged(runs);
+    CHECK(merged.ok());
+    Patient p, prev;
+    int src, count = 0;
+    bool ordered = true;
+    while (merged.next(p, src)) {
+        if (count % 2 == 0) ordered = ordered && p.id == count / 2 + 1 && p.name[0] == 'a';
+        else ordered = ordered && p.id == prev.id && p.name[0] == 'b';
+        prev = p;
+        ++count;
+    }
+    CHECK(ordered);
+    CHECK(count == 4000);
+    CHECK(merged.ok());
+}
+
+// A run that cannot be opened fails the merge instead of reading as empty.
+void testMergeMissingRun() {
+    writeShuffledPatients("input.txt", 500, 11);
+    TempFileSet temps;
+    CHECK(writeSortedRuns({ "input.txt" }, 2000, "run_", temps, [](const Patient&) {}));
+    vector<string> runs = temps.files;
+    CHECK(runs.size() > MERGE_FAN_IN);
+    runs[runs.size() / 2] = "missing_run.tmp";
+    CHECK(!mergeRunsBounded(runs, MERGE_FAN_IN, "merge_", temps));
+
+    PatientMergeStream merged({ temps.files[0], "missing_run.tmp" });
+    CHECK(!merged.ok());
+    TempFileSet more;
+    CHECK(!writeSortedRuns({ "missing_input.txt" }, 2000, "more_", more, [](const Patient&) {}));
+}
+
+// ---------------------------- Patient Import -------------------------------
+string fileBytes(const string& file) {
+    ifstream fin(file, ios::binary);
+    return string(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+}
+
+// Store 1..100; first file 51..150 out of order (sorted externally in many
+// runs), second file 101..200 in order. Shards are 100 ids wide.
+ImportResult importSample(ShardedPatientStore& store, ImportPolicy policy) {
+    for (int id = 1; id <= 100; ++id) store.addPatient(makePatient(id, "store"));
+    {
+        ofstream one("one.txt");
+        for (int id = 150; id >= 51; --id) one << makePatient(id, "one").serialize() << '\n';
+        ofstream two("two.txt");
+        for (int id = 101; id <= 200; ++id) two << makePatient(id, "two").serialize() << '\n';
+    }
+    return importPatientFiles(store, { "one.txt", "two.txt" }, policy, 2000, "conflicts.txt");
+}
+
+string nameOf(ShardedPatientStore& store, int id) {
+    Patient p;
+    return store.getById(id, p) ? p.name : "";
+}
+
+void testImportNewestWins() {
+    ShardedPatientStore store("patients.manifest", 100);
+    ImportResult r = importSample(store, ImportPolicy::NewestWins);
+    CHECK(r.ok());
+    CHECK(r.rowsRead == 200);
+    CHECK(r.imported == 200);
+    CHECK(r.conflicts == 100);
+    CHECK(store.size() == 200);
+    CHECK(nameOf(store, 50) == "store50");
+    CHECK(nameOf(store, 51) == "one51");
+    CHECK(nameOf(store, 101) == "two101");
+    CHECK(nameOf(store, 200) == "two200");
+}
+
+void testImportKeepFirst() {
+    ShardedPatientStore store("patients.manifest", 100);
+    ImportResult r = importSample(store, ImportPolicy::KeepFirst);
+    CHECK(r.ok());
+    CHECK(r.imported == 200);
+    CHECK(r.conflicts == 100);
+    CHECK(nameOf(store, 51) == "store51");
+    CHECK(nameOf(store, 150) == "one150");
+    CHECK(nameOf(store, 151) == "two151");
+    CHECK(!ifstream("conflicts.txt"));          // only ReportConflicts writes it
+}
+
+void testImportReportConflicts() {
+    ShardedPatientStore store("patients.manifest", 100);
+    ImportResult r = importSample(store, ImportPolicy::ReportConflicts);
+    CHECK(r.ok());
+    CHECK(r.imported == 200);
+    CHECK(r.conflicts == 100);
+    CHECK(nameOf(store, 100) == "store100");
+    CHECK(nameOf(store, 101) == "one101");
+    ifstream log("conflicts.txt");
+    string line;
+    int lines = 0;
+    bool ok = true;
+    while (getline(log, line)) {
+        vector<string> f = splitFields(line);
+        int id = f.size() > 3 ? atoi(f[0].c_str()) : 0;
+        string want = id <= 100 ? "0|1" : "1|2";
+        ok = ok && id >= 51 && id <= 150 && f[1] + '|' + f[2] == want;
+        ++lines;
+    }
+    CHECK(ok);
+    CHECK(lines == 100);
+}
+
+// A damaged shard would be rebuilt without its records: the import is
+// refused and both shard files are left as they were.
+void testImportDamagedShard() {
+    {
+        ShardedPatientStore store("patients.manifest", 100);
+        store.setFormat(StorageFormat::Packed);
+        for (int id = 1; id <= 150; ++id) store.addPatient(makePatient(id, "store"));
+        CHECK(store.saveToFile());
+    }
+    string bad = fileBytes("patients_0_99.txt");
+    CHECK(bad.size() > 16);
+    bad[bad.size() / 2] ^= 0x5A;
+    ofstream("patients_0_99.txt", ios::binary) << bad;
+    string good = fileBytes("patients_100_199.txt");
+
+    ShardedPatientStore store("patients.manifest", 100);
+    CHECK(store.loadFromFile());
+    ofstream("one.txt") << makePatient(500, "one").serialize() << '\n';
+    ImportResult r = importPatientFiles(store, { "one.txt" }, ImportPolicy::NewestWins, 2000, "conflicts.txt");
+    CHECK(!r.ok());
+    CHECK(r.error.find("patients_0_99.txt") != string::npos);
+    CHECK(!store.contains(500));
+    CHECK(store.contains(150));
+    CHECK(fileBytes("patients_0_99.txt") == bad);
+    CHECK(fileBytes("patients_100_199.txt") == good);
+}
+
+void testImportMissingFile() {
+    ShardedPatientStore store("patients.manifest", 100);
+    for (int id = 1; id <= 10; ++id) store.addPatient(makePatient(id, "store"));
+    ImportResult r = importPatientFiles(store, { "missing.txt" }, ImportPolicy::NewestWins, 2000, "conflicts.txt");
+    CHECK(!r.ok());
+    CHECK(store.size() == 10);
+}
+
+// ---------------------------- Damaged Packed Files -------------------------
+// One bad block out of two: the good block's emergencies are queued, the
+// file is kept as it was and can still be saved elsewhere.
+void testDamagedEmergenciesLoadThenSave() {
+    const int n = (int)PACKED_BLOCK + 500;
+    {
+        EmergencyManager em;
+        em.setFormat(StorageFormat::Packed);
+        for (int i = 1; i <= n; ++i) em.scheduleEmergency(EmergencyItem(i, i % 10, "case", 1000 + i));
+        CHECK(em.saveToFile("emergencies.txt"));
+    }
+    string bad = fileBytes("emergencies.txt");
+    bad[bad.size() / 4] ^= 0x5A;                // inside the first block
+    ofstream("emergencies.txt", ios::binary) << bad;
+
+    EmergencyManager em;
+    CHECK(!em.loadFromFile("emergencies.txt"));
+    CHECK(em.damaged());
+    CHECK(em.damagedPath() == "emergencies.txt");
+    CHECK(em.size() == n - (int)PACKED_BLOCK);
+    CHECK(!em.saveToFile("emergencies.txt"));
+    CHECK(fileBytes("emergencies.txt") == bad);
+    CHECK(em.saveToFile("recovered.txt"));
+
+    EmergencyManager back;
+    CHECK(back.loadFromFile("recovered.txt"));
+    CHECK(!back.damaged());
+    CHECK(back.size() == n - (int)PACKED_BLOCK);
+}
+
+// A damaged packed shard refuses operations on its id range and saves, and
+// keeps its file; other shards carry on.
+void testDamagedShardLoadThenSave() {
+    {
+        ShardedPatientStore store("patients.manifest", 100);
+        store.setFormat(StorageFormat::Packed);
+        for (int id = 1; id <= 150; ++id) store.addPatient(makePatient(id));
+        CHECK(store.saveToFile());
+    }
+    string bad = fileBytes("patients_0_99.txt");
+    bad[bad.size() / 2] ^= 0x5A;
+    ofstream("patients_0_99.txt", ios::binary) << bad;
+
+    ShardedPatientStore store("patients.manifest", 100);
+    CHECK(store.loadFromFile());
+    CHECK(!store.contains(5));
+    CHECK(!store.addPatient(makePatient(99)));
+    string file;
+    CHECK(store.damagedShardFor(5, file) && file == "patients_0_99.txt");
+    CHECK(store.addPatient(makePatient(160)));
+    CHECK(!store.saveToFile());
+    CHECK(fileBytes("patients_0_99.txt") == bad);
+
+    ShardedPatientStore back("patients.manifest", 100);
+    CHECK(back.loadFromFile());
+    CHECK(back.contains(160));
+}
+
+// ---------------------------- Main -----------------------------------------
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+int main(int argc, char** argv) {
+    const TestCase tests[] = {
+        { "snapshot_isolation", testSnapshotIsolation },
+        { "merge_beyond_fan_in", testMergeBeyondFanIn },
+        { "merge_missing_run", testMergeMissingRun },
+        { "import_newest_wins", testImportNewestWins },
+        { "import_keep_first", testImportKeepFirst },
+        { "import_report_conflicts", testImportReportConflicts },
+        { "import_damaged_shard", testImportDamagedShard },
+        { "import_missing_file", testImportMissingFile },
+        { "damaged_emergencies_load_then_save", testDamagedEmergenciesLoadThenSave },
+        { "damaged_shard_load_then_save", testDamagedShardLoadThenSave },
+    };
+    StatsPause quiet;                           // tests do not feed the latency stats
+    filesystem::path root = filesystem::temp_directory_path() / ("hospital_tests_" + to_string(nowMillis()));
+    filesystem::path home = filesystem::current_path();
+    int failed = 0, ran = 0;
+    for (const auto& t : tests) {
+        if (argc > 1 && string(argv[1]) != t.name) continue;
+        filesystem::create_directories(root / t.name);
+        filesystem::current_path(root / t.name);
+        int before = checkFailures;
+        t.run();
+        filesystem::current_path(home);
+        bool ok = checkFailures == before;
+        cout << (ok ? "PASS " : "FAIL ") << t.name << '\n';
+        failed += !ok;
+        ++ran;
+    }
+    if (failed == 0) filesystem::remove_all(root);
+    else cout << "Files of the failed tests are kept in " << root.string() << '\n';
+    cout << ran - failed << " of " << ran << " tests passed\n";
+    return failed == 0 && ran > 0 ? 0 : 1;
+}